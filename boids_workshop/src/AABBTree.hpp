@@ -0,0 +1,350 @@
+#pragma once
+#include "raylib.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// AABBTree is a dynamic bounding volume hierarchy over points, in the style of Box2D's b2DynamicTree.
+// Every object gets a leaf with a "fat" box: its position grown by 'margin' and stretched along its velocity.
+// As long as an object stays inside its fat box the tree is left untouched. Objects that leave are removed and
+// reinserted, which refits the boxes on the path to the root and rebalances it with AVL-style rotations.
+// Every 'ROTATION_INTERVAL' frames a full pass of surface area-reducing tree rotations cleans up the quality
+// loss from all those incremental updates (Kopta et al. "Fast, Effective BVH Updates for Animated Scenes").
+// For scenes where most agents move slowly, this is far cheaper than building a new tree every frame.
+
+template<class T>
+class AABBTree{
+   using node_idx = uint32_t; // index to a node in the 'nodes' vector
+   using index_t = uint32_t; // index to an object in the original collection
+   static constexpr node_idx NO_NODE = static_cast<node_idx>(-1);
+   static constexpr uint32_t ROTATION_INTERVAL = 30; // frames between full tree rotation passes
+   static constexpr float PREDICTION_TIME = 0.25f;   // seconds of movement the fat boxes are stretched to cover
+
+   struct Node final{
+      Rectangle box{0, 0, 0, 0};   // fat box for leaves, union of the children for internal nodes
+      const T* object = nullptr;   // only set for leaves
+      node_idx parent = NO_NODE;   // for free nodes; the next node in the free list
+      node_idx left = NO_NODE;
+      node_idx right = NO_NODE;
+      int32_t height = 0;          // leaves are 0, free nodes are -1
+
+      constexpr bool is_leaf() const noexcept{
+         return left == NO_NODE;
+      }
+   };
+
+   std::vector<Node> nodes;         // node pool, freed nodes are chained through 'parent' and reused.
+   std::vector<node_idx> leaf_of;   // the leaf of every object, indexed like the tracked collection.
+   const T* tracked = nullptr;      // the collection we were built from, anything else forces a rebuild.
+   size_t tracked_count = 0;
+   node_idx root = NO_NODE;
+   node_idx free_list = NO_NODE;
+   float margin = 10.0f;            // how far an object can wander in any direction before it is reinserted.
+   uint32_t frames_since_rotation = 0;
+
+   static constexpr float right_of(const Rectangle& r) noexcept{ return r.x + r.width; }
+   static constexpr float bottom_of(const Rectangle& r) noexcept{ return r.y + r.height; }
+
+   static constexpr Rectangle merge(const Rectangle& a, const Rectangle& b) noexcept{
+      const float x = std::min(a.x, b.x);
+      const float y = std::min(a.y, b.y);
+      return {x, y, std::max(right_of(a), right_of(b)) - x, std::max(bottom_of(a), bottom_of(b)) - y};
+   }
+
+   // the 2D equivalent of surface area, the cost metric for insertion and rotations.
+   static constexpr float perimeter(const Rectangle& r) noexcept{
+      return 2.0f * (r.width + r.height);
+   }
+
+   static constexpr bool contains(const Rectangle& r, Vector2 p) noexcept{
+      return p.x >= r.x && p.x <= right_of(r) && p.y >= r.y && p.y <= bottom_of(r);
+   }
+
+   static constexpr bool overlaps(const Rectangle& a, const Rectangle& b) noexcept{
+      return a.x <= right_of(b) && b.x <= right_of(a) && a.y <= bottom_of(b) && b.y <= bottom_of(a);
+   }
+
+   Rectangle fat_box_of(const T& obj) const noexcept{
+      Rectangle box = {obj.position.x - margin, obj.position.y - margin, margin * 2, margin * 2};
+      if constexpr(requires{ obj.velocity; }){ // predict where the object is headed and make room for it.
+         const Vector2 ahead = {obj.position.x + obj.velocity.x * PREDICTION_TIME, obj.position.y + obj.velocity.y * PREDICTION_TIME};
+         box = merge(box, {ahead.x - margin, ahead.y - margin, margin * 2, margin * 2});
+      }
+      return box;
+   }
+
+   node_idx allocate_node(){
+      if(free_list == NO_NODE){
+         nodes.emplace_back();
+         return static_cast<node_idx>(nodes.size() - 1);
+      }
+      const node_idx id = free_list;
+      free_list = nodes[id].parent;
+      nodes[id] = Node{};
+      return id;
+   }
+
+   void free_node(node_idx id) noexcept{
+      nodes[id].parent = free_list;
+      nodes[id].height = -1;
+      free_list = id;
+   }
+
+   void update_from_children(node_idx id) noexcept{
+      Node& node = nodes[id];
+      const Node& left = nodes[node.left];
+      const Node& right = nodes[node.right];
+      node.box = merge(left.box, right.box);
+      node.height = 1 + std::max(left.height, right.height);
+   }
+
+   void replace_child(node_idx parent, node_idx old_child, node_idx new_child) noexcept{
+      if(parent == NO_NODE){
+         root = new_child;
+      } else if(nodes[parent].left == old_child){
+         nodes[parent].left = new_child;
+      } else{
+         assert(nodes[parent].right == old_child);
+         nodes[parent].right = new_child;
+      }
+      nodes[new_child].parent = parent;
+   }
+
+   // If one child of 'a' is more than one level taller than the other, rotate its taller grandchild up.
+   // Returns the node that now sits where 'a' used to be.
+   node_idx balance(node_idx a) noexcept{
+      if(nodes[a].is_leaf() || nodes[a].height < 2){
+         return a;
+      }
+      const node_idx b = nodes[a].left;
+      const node_idx c = nodes[a].right;
+      const int32_t skew = nodes[c].height - nodes[b].height;
+      if(skew > 1){
+         return rotate_up(a, c, b);
+      }
+      if(skew < -1){
+         return rotate_up(a, b, c);
+      }
+      return a;
+   }
+
+   // 'tall' is a child of 'a', 'other' the other child. 'tall' takes the place of 'a',
+   // 'a' becomes a child of 'tall' and adopts the shorter of the grandchildren.
+   node_idx rotate_up(node_idx a, node_idx tall, node_idx other) noexcept{
+      const node_idx f = nodes[tall].left;
+      const node_idx g = nodes[tall].right;
+      replace_child(nodes[a].parent, a, tall);
+      nodes[tall].left = a;
+      nodes[a].parent = tall;
+      const bool keep_f = nodes[f].height > nodes[g].height;
+      const node_idx taller = keep_f ? f : g;
+      const node_idx shorter = keep_f ? g : f;
+      nodes[tall].right = taller;
+      nodes[a].left = other;
+      nodes[a].right = shorter;
+      nodes[shorter].parent = a;
+      nodes[other].parent = a;
+      update_from_children(a);
+      update_from_children(tall);
+      return tall;
+   }
+
+   // Walks from 'id' to the root, rebalancing and refitting every ancestor.
+   void refit_ancestors(node_idx id) noexcept{
+      while(id != NO_NODE){
+         id = balance(id);
+         update_from_children(id);
+         id = nodes[id].parent;
+      }
+   }
+
+   // Descends from the root towards the sibling that minimizes the total perimeter added to the tree.
+   node_idx find_best_sibling(const Rectangle& box) const noexcept{
+      node_idx id = root;
+      while(!nodes[id].is_leaf()){
+         const Node& node = nodes[id];
+         const float combined = perimeter(merge(node.box, box));
+         const float cost_here = 2.0f * combined; // cost of making a new parent for this node and the leaf
+         const float inherited = 2.0f * (combined - perimeter(node.box)); // every ancestor below this grows too
+         const auto descend_cost = [&](node_idx child){
+            const Node& c = nodes[child];
+            const float grown = perimeter(merge(c.box, box));
+            return inherited + (c.is_leaf() ? grown : grown - perimeter(c.box));
+         };
+         const float cost_left = descend_cost(node.left);
+         const float cost_right = descend_cost(node.right);
+         if(cost_here < cost_left && cost_here < cost_right){
+            break;
+         }
+         id = (cost_left < cost_right) ? node.left : node.right;
+      }
+      return id;
+   }
+
+   void insert_leaf(node_idx leaf){
+      if(root == NO_NODE){
+         root = leaf;
+         nodes[leaf].parent = NO_NODE;
+         return;
+      }
+      const node_idx sibling = find_best_sibling(nodes[leaf].box);
+      const node_idx new_parent = allocate_node();
+      replace_child(nodes[sibling].parent, sibling, new_parent);
+      nodes[new_parent].left = sibling;
+      nodes[new_parent].right = leaf;
+      nodes[sibling].parent = new_parent;
+      nodes[leaf].parent = new_parent;
+      refit_ancestors(new_parent);
+   }
+
+   void remove_leaf(node_idx leaf) noexcept{
+      if(leaf == root){
+         root = NO_NODE;
+         return;
+      }
+      const node_idx parent = nodes[leaf].parent;
+      const node_idx sibling = (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+      const node_idx grand_parent = nodes[parent].parent;
+      replace_child(grand_parent, parent, sibling); // the sibling takes the place of our parent
+      free_node(parent);
+      refit_ancestors(grand_parent);
+   }
+
+   // Swaps 'a's child 'near' with the grandchild that most reduces the perimeter of 'far', 'a's other child.
+   // The box of 'a' is unchanged, since it still holds the same leaves.
+   float try_rotation(node_idx near, node_idx far, node_idx& best_near, node_idx& best_grandchild) const noexcept{
+      if(nodes[far].is_leaf()){
+         return 0.0f;
+      }
+      const Node& f = nodes[far];
+      const float before = perimeter(f.box);
+      const float keep_right = before - perimeter(merge(nodes[near].box, nodes[f.right].box)); // near <-> far.left
+      const float keep_left = before - perimeter(merge(nodes[f.left].box, nodes[near].box));  // near <-> far.right
+      const float gain = std::max(keep_right, keep_left);
+      best_near = near;
+      best_grandchild = (keep_right >= keep_left) ? f.left : f.right;
+      return gain;
+   }
+
+   void rotate(node_idx a) noexcept{
+      const node_idx b = nodes[a].left;
+      const node_idx c = nodes[a].right;
+      node_idx near_b = NO_NODE, grand_c = NO_NODE, near_c = NO_NODE, grand_b = NO_NODE;
+      const float gain_b = try_rotation(b, c, near_b, grand_c);
+      const float gain_c = try_rotation(c, b, near_c, grand_b);
+      if(std::max(gain_b, gain_c) <= 0.0f){
+         return;
+      }
+      const node_idx near = (gain_b >= gain_c) ? near_b : near_c;
+      const node_idx grandchild = (gain_b >= gain_c) ? grand_c : grand_b;
+      const node_idx far = nodes[grandchild].parent;
+      if(nodes[far].left == grandchild){
+         nodes[far].left = near;
+      } else{
+         nodes[far].right = near;
+      }
+      if(nodes[a].left == near){
+         nodes[a].left = grandchild;
+      } else{
+         nodes[a].right = grandchild;
+      }
+      nodes[near].parent = far;
+      nodes[grandchild].parent = a;
+      update_from_children(far);
+      update_from_children(a);
+   }
+
+   // Post-order, so every node is rotated after its subtrees have settled.
+   void rotate_recursive(node_idx id) noexcept{
+      if(nodes[id].is_leaf()){
+         return;
+      }
+      rotate_recursive(nodes[id].left);
+      rotate_recursive(nodes[id].right);
+      update_from_children(id); // a rotation below can change our height, even though our box stays the same.
+      rotate(id);
+   }
+
+   void query_range_recursive(node_idx id, const Rectangle& range, std::vector<const T*>& found) const{
+      const Node& node = nodes[id];
+      if(!overlaps(node.box, range)){
+         return;
+      }
+      if(node.is_leaf()){
+         if(CheckCollisionPointRec(node.object->position, range)){
+            found.push_back(node.object);
+         }
+         return;
+      }
+      query_range_recursive(node.left, range, found);
+      query_range_recursive(node.right, range, found);
+   }
+
+   void build(std::span<const T> objects){
+      nodes.clear();
+      leaf_of.clear();
+      root = NO_NODE;
+      free_list = NO_NODE;
+      tracked = objects.data();
+      tracked_count = objects.size();
+      nodes.reserve(objects.size() * 2); // n leaves and n - 1 internal nodes
+      leaf_of.reserve(objects.size());
+      for(const auto& obj : objects){
+         const node_idx leaf = allocate_node();
+         nodes[leaf].box = fat_box_of(obj);
+         nodes[leaf].object = std::addressof(obj);
+         leaf_of.push_back(leaf);
+         insert_leaf(leaf);
+      }
+   }
+
+   // Reinserts every object that left its fat box. Everything else stays exactly where it is.
+   void refit(std::span<const T> objects){
+      for(index_t i = 0; i < leaf_of.size(); ++i){
+         const node_idx leaf = leaf_of[i];
+         if(contains(nodes[leaf].box, objects[i].position)){
+            continue;
+         }
+         remove_leaf(leaf);
+         nodes[leaf].box = fat_box_of(objects[i]);
+         insert_leaf(leaf);
+      }
+      if(++frames_since_rotation >= ROTATION_INTERVAL && root != NO_NODE){
+         rotate_recursive(root);
+         frames_since_rotation = 0;
+      }
+   }
+
+public:
+   AABBTree() = default;
+   explicit AABBTree(std::span<const T> objects, float margin_ = 10.0f)
+      : margin(margin_){
+      assert(margin >= 0.0f);
+      build(objects);
+   }
+
+   // Unlike the other indices this does not start over: as long as we're handed the same collection
+   // the tree is refit, and only objects that moved out of their fat boxes are reinserted.
+   void rebuild(std::span<const T> objects){
+      if(objects.data() != tracked || objects.size() != tracked_count){
+         build(objects);
+         return;
+      }
+      refit(objects);
+   }
+
+   void render() const noexcept{
+      for(const auto& node : nodes){
+         if(node.height >= 0){
+            DrawRectangleLinesEx(node.box, 1, node.is_leaf() ? GREEN : DARKGREEN);
+         }
+      }
+   }
+
+   void query_range(const Rectangle& range, std::vector<const T*>& found) const{
+      if(root == NO_NODE){ return; }
+      query_range_recursive(root, range, found);
+   }
+};
@@ -0,0 +1,148 @@
+#pragma once
+#include "raylib.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// CostMap shows where the simulation spends its time. Every boid reports what its step cost (neighbours tested by
+// its query, nanoseconds spent querying and steering), and the reports are summed into a coarse grid by position.
+// Dense clumps and obstacle edges light up, and drawn under the quadtree it shows how the depth limit leaves big
+// crowded leaves that every query in the area has to scan.
+// Reports go into a slot per boid, so the parallel queries can record without sharing anything. finish_frame()
+// bins them on one thread. The overlay shows a decaying average, the dump has the totals since the last clear().
+
+class CostMap final{
+public:
+   enum Metric : size_t{ BOIDS, TESTED, QUERY_NS, STEER_NS, METRIC_COUNT };
+
+   static constexpr std::string_view to_string(Metric metric) noexcept{
+      switch(metric){
+      case BOIDS: return "boids";
+      case TESTED: return "neighbours tested";
+      case QUERY_NS: return "query time";
+      case STEER_NS: return "steering time";
+      case METRIC_COUNT: break;
+      }
+      return "unknown";
+   }
+
+private:
+   struct Report final{
+      Vector2 position{0, 0};
+      float tested = 0.0f;
+      float query_ns = 0.0f;
+      float steer_ns = 0.0f;
+   };
+   using Grid = std::vector<double>; // row-major, 'columns' x 'rows'
+   static constexpr double DECAY = 0.95; // per frame, for the overlay
+
+   std::vector<Report> reports;
+   std::array<Grid, METRIC_COUNT> totals;
+   std::array<Grid, METRIC_COUNT> recent;
+   float cell_size;
+   size_t columns;
+   size_t rows;
+   uint64_t frames = 0;
+
+   size_t cell_of(Vector2 position) const noexcept{
+      const auto x = static_cast<size_t>(std::clamp(position.x / cell_size, 0.0f, static_cast<float>(columns - 1)));
+      const auto y = static_cast<size_t>(std::clamp(position.y / cell_size, 0.0f, static_cast<float>(rows - 1)));
+      return y * columns + x;
+   }
+
+public:
+   CostMap(Vector2 world_size, float cell_size_)
+      : cell_size(cell_size_),
+      columns(std::max<size_t>(1, static_cast<size_t>(std::ceil(world_size.x / cell_size_)))),
+      rows(std::max<size_t>(1, static_cast<size_t>(std::ceil(world_size.y / cell_size_)))){
+      for(auto& grid : totals){
+         grid.assign(columns * rows, 0.0);
+      }
+      recent = totals;
+   }
+
+   // Call before the step. Every boid's report starts out empty.
+   void begin_frame(size_t boid_count){
+      reports.assign(boid_count, Report{});
+   }
+
+   // Safe to call in parallel for different boids.
+   void record_query(size_t boid, Vector2 position, size_t tested, float nanoseconds) noexcept{
+      reports[boid].position = position;
+      reports[boid].tested = static_cast<float>(tested);
+      reports[boid].query_ns = nanoseconds;
+   }
+   void record_steering(size_t boid, Vector2 position, float nanoseconds) noexcept{
+      reports[boid].position = position; // boids that kept last step's neighbours didn't query
+      reports[boid].steer_ns = nanoseconds;
+   }
+
+   // Bins this frame's reports by where the boid was when it steered.
+   void finish_frame() noexcept{
+      for(auto& grid : recent){
+         for(auto& value : grid){
+            value *= DECAY;
+         }
+      }
+      for(const auto& report : reports){
+         const size_t cell = cell_of(report.position);
+         const std::array<double, METRIC_COUNT> values = {1.0, report.tested, report.query_ns, report.steer_ns};
+         for(size_t m = 0; m < METRIC_COUNT; ++m){
+            totals[m][cell] += values[m];
+            recent[m][cell] += values[m] * (1.0 - DECAY);
+         }
+      }
+      ++frames;
+   }
+
+   void clear() noexcept{
+      for(size_t m = 0; m < METRIC_COUNT; ++m){
+         std::ranges::fill(totals[m], 0.0);
+         std::ranges::fill(recent[m], 0.0);
+      }
+      frames = 0;
+   }
+
+   // The hottest cells are opaque red, cold ones transparent. Returns the hottest cell's value, per frame.
+   double render(Metric metric) const noexcept{
+      const Grid& grid = recent[metric];
+      const double peak = *std::ranges::max_element(grid);
+      if(peak <= 0.0){
+         return 0.0;
+      }
+      for(size_t y = 0; y < rows; ++y){
+         for(size_t x = 0; x < columns; ++x){
+            const auto heat = static_cast<float>(grid[y * columns + x] / peak);
+            DrawRectangleRec({static_cast<float>(x) * cell_size, static_cast<float>(y) * cell_size, cell_size, cell_size}, Fade(RED, heat * 0.6f));
+         }
+      }
+      return peak;
+   }
+
+   // One row per cell with its totals and per-frame averages. CSV, for a spreadsheet or a plotting script.
+   bool dump(const std::string& path) const{
+      std::ofstream file(path);
+      if(!file){
+         TraceLog(LOG_WARNING, "COSTMAP: Failed to write '%s'", path.c_str());
+         return false;
+      }
+      const double per_frame = frames ? 1.0 / static_cast<double>(frames) : 0.0;
+      file << "x,y,frames,boids,tested,query_us,steer_us,boids_per_frame,tested_per_frame,us_per_frame\n";
+      for(size_t y = 0; y < rows; ++y){
+         for(size_t x = 0; x < columns; ++x){
+            const size_t c = y * columns + x;
+            const double us = (totals[QUERY_NS][c] + totals[STEER_NS][c]) / 1000.0;
+            file << static_cast<float>(x) * cell_size << ',' << static_cast<float>(y) * cell_size << ',' << frames << ','
+               << totals[BOIDS][c] << ',' << totals[TESTED][c] << ',' << totals[QUERY_NS][c] / 1000.0 << ',' << totals[STEER_NS][c] / 1000.0 << ','
+               << totals[BOIDS][c] * per_frame << ',' << totals[TESTED][c] * per_frame << ',' << us * per_frame << '\n';
+         }
+      }
+      return static_cast<bool>(file);
+   }
+};
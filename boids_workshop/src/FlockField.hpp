@@ -0,0 +1,196 @@
+#pragma once
+#include "raylib.h"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// FlockField is a particle-in-cell approximation of the neighbourhood sums behind cohesion and alignment.
+// Boids splat their position and velocity into a coarse grid, the grid is smoothed with a separable blur the
+// size of the vision range, and each boid then reads its "neighbours" average from a single bilinear sample.
+// That is O(boids + cells) instead of O(boids * neighbours), and it doesn't care how densely the flock is packed.
+// Like the neighbour queries, the field does not reach across the world's wrapping edges.
+
+class FlockField final{
+public:
+   struct Sample final{
+      float density = 0.0f;       // blurred boid count around the sample point
+      Vector2 center{0, 0};       // average position of those boids
+      Vector2 velocity{0, 0};     // average velocity of those boids
+   };
+
+private:
+   enum Channel : size_t{ DENSITY, POSITION_X, POSITION_Y, VELOCITY_X, VELOCITY_Y, CHANNEL_COUNT };
+   using Grid = std::vector<float>; // row-major, 'columns' x 'rows'
+   static constexpr size_t MIN_BOIDS_PER_WORKER = 16384; // splatting is cheap, only fan out for big flocks.
+
+   std::array<Grid, CHANNEL_COUNT> channels;
+   std::vector<std::array<Grid, CHANNEL_COUNT>> worker_channels; // private splat targets, summed after the splat.
+   Grid padded;   // one row with 'radius' empty cells on either side, for the horizontal blur.
+   Grid blurred;  // result of the horizontal blur, input to the vertical one.
+   Vector2 world_size{0, 0};
+   float cell_size = 16.0f;
+   size_t columns = 0;
+   size_t rows = 0;
+
+   static constexpr bool in_range(ptrdiff_t i, size_t n) noexcept{
+      return i >= 0 && i < static_cast<ptrdiff_t>(n);
+   }
+
+   static constexpr size_t clamped(ptrdiff_t i, size_t n) noexcept{
+      return static_cast<size_t>(std::clamp<ptrdiff_t>(i, 0, static_cast<ptrdiff_t>(n) - 1));
+   }
+
+   // Cloud-in-cell: each boid is spread over the four cells around it, weighted by overlap.
+   template<class T>
+   void splat_range(std::array<Grid, CHANNEL_COUNT>& target, std::span<const T> boids, size_t begin, size_t end) const noexcept{
+      for(size_t i = begin; i < end; ++i){
+         const T& boid = boids[i];
+         const float gx = boid.position.x / cell_size - 0.5f;
+         const float gy = boid.position.y / cell_size - 0.5f;
+         const float fx = std::floor(gx);
+         const float fy = std::floor(gy);
+         const float tx = gx - fx;
+         const float ty = gy - fy;
+         const auto x0 = static_cast<ptrdiff_t>(fx);
+         const auto y0 = static_cast<ptrdiff_t>(fy);
+         const std::array<float, 2> wx = {1 - tx, tx};
+         const std::array<float, 2> wy = {1 - ty, ty};
+         for(ptrdiff_t dy = 0; dy < 2; ++dy){
+            for(ptrdiff_t dx = 0; dx < 2; ++dx){
+               if(!in_range(x0 + dx, columns) || !in_range(y0 + dy, rows)){
+                  continue; // the part of the boid that falls outside the world is dropped.
+               }
+               const size_t cell = static_cast<size_t>(y0 + dy) * columns + static_cast<size_t>(x0 + dx);
+               const float w = wx[static_cast<size_t>(dx)] * wy[static_cast<size_t>(dy)];
+               target[DENSITY][cell] += w;
+               target[POSITION_X][cell] += w * boid.position.x;
+               target[POSITION_Y][cell] += w * boid.position.y;
+               target[VELOCITY_X][cell] += w * boid.velocity.x;
+               target[VELOCITY_Y][cell] += w * boid.velocity.y;
+            }
+         }
+      }
+   }
+
+   // Tent filter, applied along rows then along columns. Both inner loops run over contiguous floats with a
+   // constant weight, so the compiler can vectorise them. Cells beyond the edges count as empty.
+   void blur_channel(Grid& grid, size_t radius){
+      const auto r = static_cast<ptrdiff_t>(radius);
+      blurred.assign(grid.size(), 0.0f);
+      for(size_t y = 0; y < rows; ++y){
+         const float* row = grid.data() + y * columns;
+         std::ranges::copy(std::span{row, columns}, padded.begin() + r);
+         float* out = blurred.data() + y * columns;
+         for(ptrdiff_t k = -r; k <= r; ++k){
+            const auto weight = static_cast<float>(r + 1 - std::abs(k));
+            const float* in = padded.data() + (k + r);
+            for(size_t x = 0; x < columns; ++x){
+               out[x] += weight * in[x];
+            }
+         }
+      }
+      std::ranges::fill(grid, 0.0f);
+      for(size_t y = 0; y < rows; ++y){
+         float* out = grid.data() + y * columns;
+         for(ptrdiff_t k = -r; k <= r; ++k){
+            if(!in_range(static_cast<ptrdiff_t>(y) + k, rows)){
+               continue;
+            }
+            const auto weight = static_cast<float>(r + 1 - std::abs(k));
+            const float* in = blurred.data() + static_cast<size_t>(static_cast<ptrdiff_t>(y) + k) * columns;
+            for(size_t x = 0; x < columns; ++x){
+               out[x] += weight * in[x];
+            }
+         }
+      }
+   }
+
+   float bilinear(const Grid& grid, Vector2 pos) const noexcept{
+      const float gx = pos.x / cell_size - 0.5f;
+      const float gy = pos.y / cell_size - 0.5f;
+      const float fx = std::floor(gx);
+      const float fy = std::floor(gy);
+      const float tx = gx - fx;
+      const float ty = gy - fy;
+      const size_t x0 = clamped(static_cast<ptrdiff_t>(fx), columns);
+      const size_t y0 = clamped(static_cast<ptrdiff_t>(fy), rows);
+      const size_t x1 = clamped(static_cast<ptrdiff_t>(fx) + 1, columns);
+      const size_t y1 = clamped(static_cast<ptrdiff_t>(fy) + 1, rows);
+      const float top = grid[y0 * columns + x0] * (1 - tx) + grid[y0 * columns + x1] * tx;
+      const float bottom = grid[y1 * columns + x0] * (1 - tx) + grid[y1 * columns + x1] * tx;
+      return top * (1 - ty) + bottom * ty;
+   }
+
+public:
+   FlockField(Vector2 world_size_, float cell_size_)
+      : world_size(world_size_), cell_size(cell_size_){
+      assert(cell_size > 0.0f);
+      columns = std::max<size_t>(1, static_cast<size_t>(std::ceil(world_size.x / cell_size)));
+      rows = std::max<size_t>(1, static_cast<size_t>(std::ceil(world_size.y / cell_size)));
+      for(auto& channel : channels){
+         channel.resize(columns * rows);
+      }
+   }
+
+   // Splats every boid into the grid, then blurs the grid so each cell holds the sums over a 'radius' neighbourhood.
+   // 'T' needs Vector2 'position' and 'velocity' members.
+   template<class T>
+   void rebuild(std::span<const T> boids, float radius){
+      const size_t workers = workers_for(boids.size(), MIN_BOIDS_PER_WORKER);
+      worker_channels.resize(workers);
+      for(auto& target : worker_channels){
+         for(auto& grid : target){
+            grid.assign(columns * rows, 0.0f);
+         }
+      }
+      parallel_for(boids.size(), workers, [&](size_t w, size_t begin, size_t end){
+         splat_range(worker_channels[w], boids, begin, end);
+      });
+      for(size_t c = 0; c < CHANNEL_COUNT; ++c){
+         channels[c] = worker_channels[0][c];
+         for(size_t w = 1; w < workers; ++w){
+            for(size_t i = 0; i < channels[c].size(); ++i){
+               channels[c][i] += worker_channels[w][c][i];
+            }
+         }
+      }
+      const size_t blur_radius = std::min(static_cast<size_t>(radius / cell_size), std::min(columns, rows) / 2);
+      padded.assign(columns + 2 * blur_radius, 0.0f); // the padding stays zero, only the middle is overwritten per row.
+      for(auto& channel : channels){
+         blur_channel(channel, blur_radius);
+      }
+   }
+
+   Sample sample(Vector2 position) const noexcept{
+      const float density = bilinear(channels[DENSITY], position);
+      if(density <= 0.0f){
+         return {};
+      }
+      return {
+         density,
+         {bilinear(channels[POSITION_X], position) / density, bilinear(channels[POSITION_Y], position) / density},
+         {bilinear(channels[VELOCITY_X], position) / density, bilinear(channels[VELOCITY_Y], position) / density}
+      };
+   }
+
+   void render() const noexcept{
+      float peak = 0.0f;
+      for(float d : channels[DENSITY]){
+         peak = std::max(peak, d);
+      }
+      if(peak <= 0.0f){
+         return;
+      }
+      for(size_t y = 0; y < rows; ++y){
+         for(size_t x = 0; x < columns; ++x){
+            const float d = channels[DENSITY][y * columns + x] / peak;
+            DrawRectangleRec({static_cast<float>(x) * cell_size, static_cast<float>(y) * cell_size, cell_size, cell_size}, Fade(ORANGE, d * 0.4f));
+         }
+      }
+   }
+};
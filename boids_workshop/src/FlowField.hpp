@@ -0,0 +1,209 @@
+#pragma once
+#include "raylib.h"
+#include "ObstacleMap.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+// FlowField gives every boid a route to the nearest goal, around the obstacles, for the price of one lookup.
+// When the goals change we solve the eikonal equation |grad T| = 1 on a grid: T is the travel distance to the
+// nearest goal, and following -grad T is the shortest path. The solver is parallel fast sweeping (Zhao 2007):
+// the four diagonal sweep orders run concurrently on their own copy of T, the copies are merged by taking the
+// minimum, and that repeats until nothing improves. Each cell then stores the direction of steepest descent.
+// The field does not wrap around the world edges.
+
+class FlowField final{
+   static constexpr float UNREACHED = std::numeric_limits<float>::max();
+   static constexpr size_t SWEEP_COUNT = 4;
+   static constexpr size_t MAX_ITERATIONS = 32; // each iteration is four full sweeps. Mazes with many turns need more.
+
+   std::vector<float> distance;          // travel distance to the nearest goal, row-major.
+   std::vector<uint8_t> blocked;         // 1 for cells inside an obstacle.
+   std::array<std::vector<float>, SWEEP_COUNT> sweeps; // private copies of 'distance', one per sweep order.
+   std::vector<Vector2> direction;       // unit vector towards the goal, or zero if there is no way there.
+   std::vector<Vector2> goals;
+   Vector2 world_size{0, 0};
+   float cell_size = 16.0f;
+   size_t columns = 0;
+   size_t rows = 0;
+
+   constexpr size_t index_of(size_t x, size_t y) const noexcept{
+      return y * columns + x;
+   }
+
+   constexpr Vector2 center_of(size_t x, size_t y) const noexcept{
+      return {(static_cast<float>(x) + 0.5f) * cell_size, (static_cast<float>(y) + 0.5f) * cell_size};
+   }
+
+   // Godunov upwind update of one cell from its smallest neighbour along each axis.
+   float solve(const std::vector<float>& t, size_t x, size_t y) const noexcept{
+      const float left = (x > 0) ? t[index_of(x - 1, y)] : UNREACHED;
+      const float right = (x + 1 < columns) ? t[index_of(x + 1, y)] : UNREACHED;
+      const float up = (y > 0) ? t[index_of(x, y - 1)] : UNREACHED;
+      const float down = (y + 1 < rows) ? t[index_of(x, y + 1)] : UNREACHED;
+      const float a = std::min(left, right);
+      const float b = std::min(up, down);
+      const float h = cell_size;
+      if(a == UNREACHED && b == UNREACHED){
+         return UNREACHED;
+      }
+      if(std::abs(a - b) >= h){ // the wave arrives from one axis only
+         return std::min(a, b) + h;
+      }
+      return (a + b + std::sqrt(2.0f * h * h - (a - b) * (a - b))) * 0.5f;
+   }
+
+   // One Gauss-Seidel pass in the given order. Bit 0 flips the x direction, bit 1 the y direction.
+   bool sweep(std::vector<float>& t, size_t order) const noexcept{
+      bool changed = false;
+      for(size_t j = 0; j < rows; ++j){
+         const size_t y = (order & 2) ? rows - 1 - j : j;
+         for(size_t i = 0; i < columns; ++i){
+            const size_t x = (order & 1) ? columns - 1 - i : i;
+            const size_t cell = index_of(x, y);
+            if(blocked[cell]){
+               continue;
+            }
+            const float candidate = solve(t, x, y);
+            if(candidate < t[cell]){
+               t[cell] = candidate;
+               changed = true;
+            }
+         }
+      }
+      return changed;
+   }
+
+   void solve_distances(){
+      const size_t workers = std::min(SWEEP_COUNT, hardware_workers());
+      for(size_t iteration = 0; iteration < MAX_ITERATIONS; ++iteration){
+         std::array<uint8_t, SWEEP_COUNT> changed{};
+         parallel_for(SWEEP_COUNT, workers, [&](size_t, size_t begin, size_t end){
+            for(size_t order = begin; order < end; ++order){
+               sweeps[order] = distance;
+               changed[order] = sweep(sweeps[order], order);
+            }
+         });
+         if(std::ranges::none_of(changed, [](uint8_t c){ return c != 0; })){
+            return;
+         }
+         for(size_t i = 0; i < distance.size(); ++i){
+            distance[i] = std::min({sweeps[0][i], sweeps[1][i], sweeps[2][i], sweeps[3][i]});
+         }
+      }
+   }
+
+   // Steepest descent, using the smaller neighbour along each axis. Unreached neighbours (walls) are ignored.
+   void compute_directions() noexcept{
+      for(size_t y = 0; y < rows; ++y){
+         for(size_t x = 0; x < columns; ++x){
+            const size_t cell = index_of(x, y);
+            const float here = distance[cell];
+            direction[cell] = {0, 0};
+            if(here == UNREACHED || here == 0.0f){
+               continue;
+            }
+            const float left = (x > 0) ? distance[index_of(x - 1, y)] : UNREACHED;
+            const float right = (x + 1 < columns) ? distance[index_of(x + 1, y)] : UNREACHED;
+            const float up = (y > 0) ? distance[index_of(x, y - 1)] : UNREACHED;
+            const float down = (y + 1 < rows) ? distance[index_of(x, y + 1)] : UNREACHED;
+            Vector2 descent = {0, 0};
+            if(std::min(left, right) < here){
+               descent.x = (left < right) ? -(here - left) : (here - right);
+            }
+            if(std::min(up, down) < here){
+               descent.y = (up < down) ? -(here - up) : (here - down);
+            }
+            const float length = std::sqrt(descent.x * descent.x + descent.y * descent.y);
+            if(length > 0.0f){
+               direction[cell] = {descent.x / length, descent.y / length};
+            }
+         }
+      }
+   }
+
+public:
+   FlowField(Vector2 world_size_, float cell_size_)
+      : world_size(world_size_), cell_size(cell_size_){
+      assert(cell_size > 0.0f);
+      columns = std::max<size_t>(1, static_cast<size_t>(std::ceil(world_size.x / cell_size)));
+      rows = std::max<size_t>(1, static_cast<size_t>(std::ceil(world_size.y / cell_size)));
+      distance.resize(columns * rows);
+      blocked.resize(columns * rows);
+      direction.resize(columns * rows);
+   }
+
+   // Recomputes the whole field. Only call this when the goals or obstacles change, not every frame.
+   // Cells closer than 'clearance' to an obstacle, or to a wall of 'map', count as walls.
+   // 'O' needs a Vector2 'position' and a float 'radius'.
+   template<class O>
+   void rebuild(std::span<const Vector2> goals_, std::span<const O> obstacles, float clearance, const ObstacleMap* map = nullptr){
+      goals.assign(goals_.begin(), goals_.end());
+      std::ranges::fill(distance, UNREACHED);
+      for(size_t y = 0; y < rows; ++y){
+         for(size_t x = 0; x < columns; ++x){
+            const Vector2 center = center_of(x, y);
+            blocked[index_of(x, y)] = std::ranges::any_of(obstacles, [&](const O& obs){
+               const float reach = obs.radius + clearance;
+               const float dx = center.x - obs.position.x;
+               const float dy = center.y - obs.position.y;
+               return dx * dx + dy * dy < reach * reach;
+            }) || (map && map->distance_at(center) <= clearance);
+         }
+      }
+      for(const auto& goal : goals){
+         const auto x = static_cast<size_t>(std::clamp(goal.x / cell_size, 0.0f, static_cast<float>(columns - 1)));
+         const auto y = static_cast<size_t>(std::clamp(goal.y / cell_size, 0.0f, static_cast<float>(rows - 1)));
+         blocked[index_of(x, y)] = 0; // a goal inside an obstacle is still a goal.
+         distance[index_of(x, y)] = 0.0f;
+      }
+      if(!goals.empty()){
+         solve_distances();
+      }
+      compute_directions();
+   }
+
+   bool empty() const noexcept{
+      return goals.empty();
+   }
+
+   // Bilinear blend of the four nearest cell directions. Zero where there is no route, or no goal.
+   Vector2 sample(Vector2 pos) const noexcept{
+      const float gx = std::clamp(pos.x / cell_size - 0.5f, 0.0f, static_cast<float>(columns - 1));
+      const float gy = std::clamp(pos.y / cell_size - 0.5f, 0.0f, static_cast<float>(rows - 1));
+      const auto x0 = static_cast<size_t>(gx);
+      const auto y0 = static_cast<size_t>(gy);
+      const size_t x1 = std::min(x0 + 1, columns - 1);
+      const size_t y1 = std::min(y0 + 1, rows - 1);
+      const float tx = gx - static_cast<float>(x0);
+      const float ty = gy - static_cast<float>(y0);
+      const auto lerp = [](Vector2 a, Vector2 b, float t){ return Vector2{a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t}; };
+      const Vector2 top = lerp(direction[index_of(x0, y0)], direction[index_of(x1, y0)], tx);
+      const Vector2 bottom = lerp(direction[index_of(x0, y1)], direction[index_of(x1, y1)], tx);
+      return lerp(top, bottom, ty);
+   }
+
+   void render() const noexcept{
+      if(goals.empty()){
+         return;
+      }
+      constexpr size_t STRIDE = 2; // draw every other cell, or the arrows blend together.
+      const float length = cell_size * STRIDE * 0.4f;
+      for(size_t y = 0; y < rows; y += STRIDE){
+         for(size_t x = 0; x < columns; x += STRIDE){
+            const Vector2 dir = direction[index_of(x, y)];
+            const Vector2 from = center_of(x, y);
+            DrawLineV(from, {from.x + dir.x * length, from.y + dir.y * length}, LIGHTGRAY);
+         }
+      }
+      for(const auto& goal : goals){
+         DrawCircleLinesV(goal, cell_size, DARKGREEN);
+      }
+   }
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Holds the simulation step to a time budget by trading accuracy for speed when the flock clumps.
+// Each quality level turns some knobs further than the one before:
+//  neighbour_cap:    steering only reads the nearest N of the boids in range (the query still finds them all).
+//  refresh_interval: a boid queries its neighbours every Nth step, staggered so 1/N of the flock refreshes each
+//                    step. The others steer by last step's neighbours, which have barely moved.
+//  far_field:        cohesion and alignment come from the FlockField, and the queries shrink to separation range.
+//  max_substeps:     fewer integration sub-steps for boids under strong forces. Less stable, much cheaper.
+// The step time is smoothed, and the level only drops after a run of steps over budget, and only rises after a
+// longer run well under it. The gap between the two (hysteresis) keeps it from flickering between levels.
+
+struct Quality final{
+   size_t neighbour_cap = std::numeric_limits<size_t>::max();
+   uint32_t refresh_interval = 1;
+   bool far_field = false;
+   int max_substeps = std::numeric_limits<int>::max();
+};
+
+constexpr std::array QUALITY_LEVELS = {
+   Quality{},                                                   // exact
+   Quality{24, 1, false, 4},
+   Quality{12, 2, false, 2},
+   Quality{12, 3, true, 2},
+   Quality{6, 4, true, 1}                                       // cheapest
+};
+
+class FrameGovernor final{
+   static constexpr float SMOOTHING = 0.1f;          // weight of the newest step in the running average
+   static constexpr float RECOVER_BELOW = 0.6f;      // fraction of the budget the step must stay under to recover
+   static constexpr uint32_t DEGRADE_AFTER = 10;     // steps over budget before the quality drops
+   static constexpr uint32_t RECOVER_AFTER = 120;    // steps under RECOVER_BELOW before it rises again
+
+   float budget_ms;
+   float smoothed_ms = 0.0f;
+   size_t level = 0;
+   uint32_t over = 0;
+   uint32_t under = 0;
+
+public:
+   explicit FrameGovernor(float budget_ms_) noexcept : budget_ms(budget_ms_){}
+
+   // Call once per step with how long it took. Returns true if the quality level changed.
+   bool record(float step_ms) noexcept{
+      smoothed_ms = (smoothed_ms == 0.0f) ? step_ms : smoothed_ms + (step_ms - smoothed_ms) * SMOOTHING;
+      over = (smoothed_ms > budget_ms) ? over + 1 : 0;
+      under = (smoothed_ms < budget_ms * RECOVER_BELOW) ? under + 1 : 0;
+      const size_t previous = level;
+      if(over >= DEGRADE_AFTER && level + 1 < QUALITY_LEVELS.size()){
+         ++level;
+      } else if(under >= RECOVER_AFTER && level > 0){
+         --level;
+      }
+      if(level == previous){
+         return false;
+      }
+      over = 0;
+      under = 0;
+      return true;
+   }
+
+   const Quality& quality() const noexcept{
+      return QUALITY_LEVELS[level];
+   }
+   size_t quality_level() const noexcept{
+      return level;
+   }
+   float average_ms() const noexcept{
+      return smoothed_ms;
+   }
+   float budget() const noexcept{
+      return budget_ms;
+   }
+};
@@ -0,0 +1,150 @@
+#pragma once
+#include "raylib.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// HierarchicalGrid is a stack of uniform grids over the same boundary, where every level doubles the cell size
+// of the one before it. Queries come in very different sizes (vision range, separation range, obstacle margins..)
+// and any single cell size is wrong for some of them: too small and a query walks dozens of cells, too big and it
+// tests dozens of objects that are out of range. Each query here picks the finest level whose cells are at least
+// as big as its radius, so it touches at most 3x3 cells.
+// All levels are built together: one pass computes every object's cell on every level, one pass scatters them.
+
+template<class T>
+class HierarchicalGrid{
+   using index_t = uint32_t; // index to an object in the original collection or data vector
+   using cell_t = uint32_t;  // index to a cell, row-major
+   static constexpr cell_t OUTSIDE = static_cast<cell_t>(-1);
+
+   struct Level final{
+      float cell_size = 0.0f;
+      cell_t columns = 0;
+      cell_t rows = 0;
+      std::vector<index_t> cell_start; // first index into 'data' for every cell, plus one past the end.
+      std::vector<index_t> cursor;     // write position for every cell during the scatter pass.
+      std::vector<const T*> data;      // object pointers, sorted by cell.
+
+      constexpr cell_t column_of(float x, float origin) const noexcept{
+         return static_cast<cell_t>(std::clamp((x - origin) / cell_size, 0.0f, static_cast<float>(columns - 1)));
+      }
+
+      constexpr cell_t row_of(float y, float origin) const noexcept{
+         return static_cast<cell_t>(std::clamp((y - origin) / cell_size, 0.0f, static_cast<float>(rows - 1)));
+      }
+   };
+
+   std::vector<Level> levels;      // finest first
+   std::vector<cell_t> cell_of;    // object-major: the cells of object 'i' are [i * levels.size(), (i + 1) * levels.size())
+   Rectangle boundary = {0, 0, 0, 0};
+
+   // the finest level with cells at least as big as the query radius, or the coarsest level if none are.
+   const Level& level_for(const Rectangle& range) const noexcept{
+      const float radius = std::max(range.width, range.height) * 0.5f;
+      for(const auto& level : levels){
+         if(level.cell_size >= radius){
+            return level;
+         }
+      }
+      return levels.back();
+   }
+
+public:
+   HierarchicalGrid() = default;
+   HierarchicalGrid(const Rectangle& boundary_, std::span<const T> objects, float finest_cell_size, size_t level_count = 4)
+      : boundary(boundary_){
+      assert(finest_cell_size > 0.0f);
+      assert(level_count > 0);
+      levels.resize(level_count);
+      float cell_size = finest_cell_size;
+      for(auto& level : levels){
+         level.cell_size = cell_size;
+         level.columns = std::max(cell_t{1}, static_cast<cell_t>(std::ceil(boundary.width / cell_size)));
+         level.rows = std::max(cell_t{1}, static_cast<cell_t>(std::ceil(boundary.height / cell_size)));
+         level.cell_start.resize(level.columns * level.rows + 1);
+         cell_size *= 2.0f;
+      }
+      rebuild(objects);
+   }
+
+   void rebuild(std::span<const T> objects){
+      const size_t level_count = levels.size();
+      for(auto& level : levels){
+         std::ranges::fill(level.cell_start, index_t{0});
+      }
+      // 1. one pass over the objects computes their cell on every level, and counts them.
+      //    cell_start[cell + 1] counts 'cell', so the scan below turns it into the start of 'cell'.
+      cell_of.resize(objects.size() * level_count);
+      for(size_t i = 0; i < objects.size(); ++i){
+         const Vector2 pos = objects[i].position;
+         const bool inside = CheckCollisionPointRec(pos, boundary);
+         for(size_t l = 0; l < level_count; ++l){
+            Level& level = levels[l];
+            const cell_t cell = inside ? level.row_of(pos.y, boundary.y) * level.columns + level.column_of(pos.x, boundary.x) : OUTSIDE;
+            cell_of[i * level_count + l] = cell;
+            if(inside){
+               ++level.cell_start[cell + 1];
+            }
+         }
+      }
+      // 2. prefix sums, one per level. These are only as long as the cell count, not the object count.
+      for(auto& level : levels){
+         for(size_t c = 1; c < level.cell_start.size(); ++c){
+            level.cell_start[c] += level.cell_start[c - 1];
+         }
+         level.cursor.assign(level.cell_start.begin(), level.cell_start.end() - 1);
+         level.data.resize(level.cell_start.back());
+      }
+      // 3. one pass over the objects scatters them into every level.
+      for(size_t i = 0; i < objects.size(); ++i){
+         for(size_t l = 0; l < level_count; ++l){
+            const cell_t cell = cell_of[i * level_count + l];
+            if(cell != OUTSIDE){
+               Level& level = levels[l];
+               level.data[level.cursor[cell]++] = std::addressof(objects[i]);
+            }
+         }
+      }
+   }
+
+   void render() const noexcept{
+      for(size_t l = 0; l < levels.size(); ++l){
+         const Level& level = levels[l];
+         const Color color = Fade(GREEN, 1.0f / static_cast<float>(levels.size() - l)); // coarse levels are drawn stronger
+         for(cell_t row = 0; row < level.rows; ++row){
+            for(cell_t column = 0; column < level.columns; ++column){
+               const cell_t cell = row * level.columns + column;
+               if(level.cell_start[cell] == level.cell_start[cell + 1]){
+                  continue;
+               }
+               DrawRectangleLinesEx({boundary.x + static_cast<float>(column) * level.cell_size, boundary.y + static_cast<float>(row) * level.cell_size, level.cell_size, level.cell_size}, 1, color);
+            }
+         }
+      }
+   }
+
+   void query_range(const Rectangle& range, std::vector<const T*>& found) const{
+      if(levels.empty() || !CheckCollisionRecs(boundary, range)){
+         return;
+      }
+      const Level& level = level_for(range);
+      const cell_t first_column = level.column_of(range.x, boundary.x);
+      const cell_t last_column = level.column_of(range.x + range.width, boundary.x);
+      const cell_t first_row = level.row_of(range.y, boundary.y);
+      const cell_t last_row = level.row_of(range.y + range.height, boundary.y);
+      for(cell_t row = first_row; row <= last_row; ++row){
+         // cells in a row are adjacent in 'data', so each row is one contiguous run.
+         const index_t begin = level.cell_start[row * level.columns + first_column];
+         const index_t end = level.cell_start[row * level.columns + last_column + 1];
+         for(index_t i = begin; i < end; ++i){
+            if(CheckCollisionPointRec(level.data[i]->position, range)){
+               found.push_back(level.data[i]);
+            }
+         }
+      }
+   }
+};
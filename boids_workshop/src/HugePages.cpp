@@ -0,0 +1,128 @@
+#include "HugePages.hpp"
+#include <atomic>
+// The OS headers stay in this file. <windows.h> clashes with raylib.h (Rectangle, CloseWindow, DrawText..).
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <cstdio>
+#include <cstring>
+#endif
+
+namespace{
+   std::atomic<PageMode> last_mode{PageMode::Heap};
+   std::atomic<uint64_t> page_allocations{0};
+
+#if defined(_WIN32)
+   // MEM_LARGE_PAGES needs SeLockMemoryPrivilege enabled on the process token. It is only there to enable if an
+   // administrator granted "Lock pages in memory" to the account, so this fails quietly on most machines.
+   bool enable_lock_memory_privilege() noexcept{
+      HANDLE token = nullptr;
+      if(!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)){
+         return false;
+      }
+      TOKEN_PRIVILEGES privileges{};
+      privileges.PrivilegeCount = 1;
+      privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+      bool enabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+         && AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+         && GetLastError() == ERROR_SUCCESS; // "succeeds" with ERROR_NOT_ALL_ASSIGNED when the account lacks the right
+      CloseHandle(token);
+      return enabled;
+   }
+
+   void* allocate(size_t bytes, PageMode& obtained) noexcept{
+      static const bool large_pages = enable_lock_memory_privilege() && GetLargePageMinimum() == HUGE_PAGE_SIZE;
+      if(large_pages){
+         if(void* memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE)){
+            obtained = PageMode::Huge;
+            return memory;
+         }
+      }
+      obtained = PageMode::Regular;
+      return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+   }
+
+   void release(void* memory, size_t) noexcept{
+      VirtualFree(memory, 0, MEM_RELEASE);
+   }
+#elif defined(__linux__)
+   // madvise(MADV_HUGEPAGE) succeeds even when THP is turned off, so ask the kernel whether it will act on it.
+   // The selected setting is the one in brackets: "always [madvise] never".
+   bool transparent_huge_pages_enabled() noexcept{
+      char modes[128]{};
+      if(FILE* file = std::fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r")){
+         if(!std::fgets(modes, sizeof(modes), file)){
+            modes[0] = '\0';
+         }
+         std::fclose(file);
+      }
+      return std::strstr(modes, "[always]") || std::strstr(modes, "[madvise]");
+   }
+
+   void* allocate(size_t bytes, PageMode& obtained) noexcept{
+      void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if(memory != MAP_FAILED){
+         obtained = PageMode::Huge;
+         return memory;
+      }
+      // over-map by one huge page and trim both ends, so the region starts on a huge page boundary.
+      // THP only backs aligned 2 MiB ranges.
+      const size_t padded = bytes + HUGE_PAGE_SIZE;
+      auto* raw = static_cast<char*>(mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+      if(raw == MAP_FAILED){
+         return nullptr;
+      }
+      const auto address = reinterpret_cast<uintptr_t>(raw);
+      const size_t head = (HUGE_PAGE_SIZE - address % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+      char* aligned = raw + head;
+      if(head > 0){
+         munmap(raw, head);
+      }
+      if(const size_t tail = padded - head - bytes; tail > 0){
+         munmap(aligned + bytes, tail);
+      }
+      static const bool transparent = transparent_huge_pages_enabled();
+      obtained = (transparent && madvise(aligned, bytes, MADV_HUGEPAGE) == 0) ? PageMode::Transparent : PageMode::Regular;
+      return aligned;
+   }
+
+   void release(void* memory, size_t bytes) noexcept{
+      munmap(memory, bytes);
+   }
+#else
+   void* allocate(size_t bytes, PageMode& obtained) noexcept{
+      obtained = PageMode::Heap;
+      return ::operator new(bytes, std::align_val_t{HUGE_PAGE_SIZE}, std::nothrow);
+   }
+
+   void release(void* memory, size_t) noexcept{
+      ::operator delete(memory, std::align_val_t{HUGE_PAGE_SIZE});
+   }
+#endif
+}
+
+void* allocate_pages(size_t bytes, PageMode& obtained) noexcept{
+   void* memory = allocate(round_to_huge_pages(bytes), obtained);
+   if(memory){
+      last_mode.store(obtained, std::memory_order_relaxed);
+      page_allocations.fetch_add(1, std::memory_order_relaxed);
+   }
+   return memory;
+}
+
+void free_pages(void* memory, size_t bytes) noexcept{
+   if(memory){
+      release(memory, round_to_huge_pages(bytes));
+   }
+}
+
+PageMode last_page_mode() noexcept{
+   return last_mode.load(std::memory_order_relaxed);
+}
+
+uint64_t page_allocation_count() noexcept{
+   return page_allocations.load(std::memory_order_relaxed);
+}
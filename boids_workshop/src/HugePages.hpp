@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <new>
+#include <string_view>
+
+// Big arrays that are read at random (boid state, spatial index data) miss the TLB constantly with 4 KiB pages:
+// a million boids span thousands of pages. Backing them with 2 MiB pages cuts that by 512x.
+// allocate_pages() asks the OS for the best it will give, and falls back step by step:
+//  Huge:        explicit large pages. MAP_HUGETLB on Linux (needs reserved hugepages), MEM_LARGE_PAGES on Windows
+//               (needs the "Lock pages in memory" privilege).
+//  Transparent: Linux only, when transparent_hugepage/enabled is 'always' or 'madvise'. A 2 MiB aligned mapping
+//               marked with madvise(MADV_HUGEPAGE). This is what was requested: the kernel backs it with huge pages
+//               as they are first touched only while it has free 2 MiB blocks, and falls back to 4 KiB pages silently.
+//  Regular:     4 KiB pages straight from the OS.
+// Allocations smaller than a huge page aren't worth it, and come from the heap, aligned to a cache line so the
+// workers' chunks of a FirstTouchArray still don't share one.
+// NUMA placement is per page, so with Huge or Transparent pages a whole 2 MiB page goes to the node of whichever
+// worker touches it first. Where a chunk boundary falls inside a page, the start of the next worker's chunk lives
+// on the previous worker's node. With chunks of many megabytes that's a small fraction of each chunk.
+
+enum class PageMode : uint8_t{ Heap, Regular, Transparent, Huge };
+
+constexpr size_t HUGE_PAGE_SIZE = size_t{2} << 20;
+
+constexpr std::string_view to_string(PageMode mode) noexcept{
+   switch(mode){
+   case PageMode::Heap: return "heap";
+   case PageMode::Regular: return "regular 4 KiB";
+   case PageMode::Transparent: return "transparent huge";
+   case PageMode::Huge: return "explicit 2 MiB";
+   }
+   return "unknown";
+}
+
+constexpr size_t round_to_huge_pages(size_t bytes) noexcept{
+   return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+// 'bytes' is rounded up to whole huge pages. Returns nullptr if the OS has nothing at all.
+void* allocate_pages(size_t bytes, PageMode& obtained) noexcept;
+// 'bytes' must be the size that was passed to allocate_pages.
+void free_pages(void* memory, size_t bytes) noexcept;
+// The mode obtained by the most recent allocation of a huge page or more, or Heap if there hasn't been one.
+PageMode last_page_mode() noexcept;
+// Successful allocate_pages calls since the program started, from any thread. See Metrics.cpp.
+uint64_t page_allocation_count() noexcept;
+
+// Standard allocator on top of allocate_pages. Stateless, so containers using it still move in O(1).
+template<class T>
+struct HugePageAllocator{
+   using value_type = T;
+   static constexpr std::align_val_t HEAP_ALIGNMENT{std::max<size_t>(alignof(T), 64)};
+
+   HugePageAllocator() noexcept = default;
+   template<class U>
+   HugePageAllocator(const HugePageAllocator<U>&) noexcept{}
+
+   T* allocate(size_t n){
+      const size_t bytes = n * sizeof(T);
+      if(bytes < HUGE_PAGE_SIZE){
+         return static_cast<T*>(::operator new(bytes, HEAP_ALIGNMENT));
+      }
+      PageMode mode = PageMode::Heap;
+      if(void* memory = allocate_pages(bytes, mode)){
+         return static_cast<T*>(memory);
+      }
+      throw std::bad_alloc{};
+   }
+
+   void deallocate(T* p, size_t n) noexcept{
+      const size_t bytes = n * sizeof(T);
+      if(bytes < HUGE_PAGE_SIZE){
+         ::operator delete(p, bytes, HEAP_ALIGNMENT);
+         return;
+      }
+      free_pages(p, bytes);
+   }
+
+   template<class U>
+   bool operator==(const HugePageAllocator<U>&) const noexcept{
+      return true;
+   }
+};
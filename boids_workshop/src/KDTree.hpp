@@ -0,0 +1,161 @@
+#pragma once
+#include "raylib.h"
+#include "SpatialIndex.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// KDTree is a median-split binary tree over points, stored like LinearQuadTree: nodes in a contiguous vector,
+// leaf objects contiguous in the 'data' vector. Every split puts half of the objects on each side of the median
+// along the widest axis of the node, so the tree adapts to the data instead of to the space. A region quadtree
+// stops subdividing at 'max_depth' and leaves tight clumps in huge leaves, a KD-tree keeps every leaf at 'capacity'.
+// Each node keeps the tight bounds of its objects, so empty space between clumps is never visited by a query.
+
+template<class T>
+class KDTree{
+   using node_idx = uint32_t; // index to a node in the 'nodes' vector
+   using index_t = uint32_t; // index to an object in the original collection or data vector
+   using count_t = uint32_t; // number of objects in a node or distance between two indexes.
+   static constexpr node_idx NO_CHILD = static_cast<node_idx>(-1);
+   static constexpr node_idx ROOT_ID = 0;
+
+   struct Node final{
+      Rectangle bounds{0, 0, 0, 0}; // tight bounds of every object below this node
+      index_t data_begin = 0;  // starting index into the 'data' vector.
+      count_t data_count = 0;  // number of objects below this node.
+      node_idx left = NO_CHILD;
+      node_idx right = NO_CHILD;
+
+      constexpr bool is_leaf() const noexcept{
+         return left == NO_CHILD && right == NO_CHILD;
+      }
+   };
+
+   std::vector<Node> nodes;      // linear storage for all nodes.
+   std::vector<const T*> data;   // all object pointers, every node owns a contiguous subrange.
+   Rectangle boundary = {0, 0, 0, 0}; // objects outside of the boundary are not indexed
+   count_t capacity = 8;   // objects per leaf
+   count_t max_depth = 16; // maximum depth allowed. Each level halves the objects, so this can be much deeper than a quadtree.
+
+   // unlike CheckCollisionRecs this accepts touching edges, tight bounds can have zero width or height.
+   static constexpr bool overlaps(const Rectangle& a, const Rectangle& b) noexcept{
+      return a.x <= b.x + b.width && b.x <= a.x + a.width
+         && a.y <= b.y + b.height && b.y <= a.y + a.height;
+   }
+
+   static constexpr bool contains(const Rectangle& outer, const Rectangle& inner) noexcept{
+      return inner.x >= outer.x && inner.y >= outer.y
+         && inner.x + inner.width < outer.x + outer.width
+         && inner.y + inner.height < outer.y + outer.height;
+   }
+
+   Rectangle bounds_of(index_t start, index_t end) const noexcept{
+      auto [min_x, min_y] = data[start]->position;
+      auto [max_x, max_y] = data[start]->position;
+      for(index_t i = start + 1; i < end; ++i){
+         const auto& pos = data[i]->position;
+         min_x = std::min(min_x, pos.x);
+         max_x = std::max(max_x, pos.x);
+         min_y = std::min(min_y, pos.y);
+         max_y = std::max(max_y, pos.y);
+      }
+      return {min_x, min_y, max_x - min_x, max_y - min_y};
+   }
+
+   // Recursively builds the tree by partitioning the 'data'-vector in-place around the median.
+   // [start, end) is the subrange to work on, 'depth' the current recursion depth.
+   // Returns the index of the new node in the 'nodes' vector.
+   node_idx build_tree(index_t start, index_t end, count_t depth){
+      assert(start < end);
+      const auto nodeIndex = static_cast<node_idx>(nodes.size());
+      const Rectangle bounds = bounds_of(start, end);
+      nodes.emplace_back(bounds, start, end - start);
+      if(end - start <= capacity || depth >= max_depth){
+         return nodeIndex;
+      }
+      // nth_element puts the median in its sorted position, with smaller objects before it and larger after.
+      // Cheaper than a sort, and it leaves both halves contiguous for the children.
+      const index_t mid = start + (end - start) / 2;
+      const bool split_x = bounds.width >= bounds.height;
+      std::nth_element(data.begin() + start, data.begin() + mid, data.begin() + end,
+         [split_x](const T* a, const T* b) noexcept{
+            return split_x ? a->position.x < b->position.x : a->position.y < b->position.y;
+         });
+      // NOTE: build_tree grows 'nodes', so we can't hold a Node& across these calls.
+      const node_idx left = build_tree(start, mid, depth + 1);
+      const node_idx right = build_tree(mid, end, depth + 1);
+      nodes[nodeIndex].left = left;
+      nodes[nodeIndex].right = right;
+      return nodeIndex;
+   }
+
+   void query_range_recursive(node_idx nodeIndex, const Rectangle& range, std::vector<const T*>& found) const{
+      const Node& node = nodes[nodeIndex];
+      if(!overlaps(node.bounds, range)){
+         return;
+      }
+      const auto first = data.begin() + node.data_begin;
+      if(contains(range, node.bounds)){ // every object below this node is inside the range, no need to test them.
+         found.insert(found.end(), first, first + node.data_count);
+         return;
+      }
+      if(node.is_leaf()){
+         for(auto it = first; it != first + node.data_count; ++it){
+            if(CheckCollisionPointRec((*it)->position, range)){
+               found.push_back(*it);
+            }
+         }
+         return;
+      }
+      query_range_recursive(node.left, range, found);
+      query_range_recursive(node.right, range, found);
+   }
+
+public:
+   KDTree() = default;
+   KDTree(const Rectangle& boundary_, std::span<const T> objects, count_t capacity_, count_t max_depth_ = 16)
+      : boundary(boundary_), capacity(capacity_), max_depth(max_depth_){
+      assert(capacity > 0);
+      assert(max_depth > 0);
+      rebuild(objects);
+   }
+
+   KDTree(std::span<const T> objects, count_t capacity_, count_t max_depth_ = 16)
+      : KDTree(compute_bounds_of(objects), objects, capacity_, max_depth_){}
+
+   void rebuild(std::span<const T> objects){
+      nodes.clear();
+      data.clear();
+      if(objects.empty()){ return; }
+      data.reserve(objects.size());
+      for(auto& obj : objects){ //NOTE: if objects are guarantueed to be within the bounds, you can skip this filtering!
+         if(CheckCollisionPointRec(obj.position, boundary)){
+            data.push_back(std::addressof(obj));
+         }
+      }
+      if(data.empty()){ return; }
+      nodes.reserve(2 * (data.size() / capacity + 1)); // a balanced binary tree has at most twice as many nodes as leaves.
+      build_tree(0, static_cast<index_t>(data.size()), 0);
+   }
+
+   void rebuild_and_fit_to(std::span<const T> objects){
+      boundary = compute_bounds_of(objects);
+      rebuild(objects);
+   }
+
+   void render() const noexcept{
+      for(const auto& node : nodes){
+         if(node.is_leaf()){
+            DrawRectangleLinesEx(node.bounds, 1, GREEN);
+         }
+      }
+   }
+
+   void query_range(const Rectangle& range, std::vector<const T*>& found) const{
+      if(nodes.empty()){ return; }
+      query_range_recursive(ROOT_ID, range, found);
+   }
+};
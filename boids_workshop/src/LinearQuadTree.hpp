@@ -1,5 +1,9 @@
 #pragma once
 #include "raylib.h"
+#include "HugePages.hpp"
+#include "SpatialIndex.hpp"
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstdint>
 #include <span>
@@ -16,6 +20,7 @@ class LinearQuadTree{
    using count_t = uint32_t; // number of objects in a node or distance between two indexes.
    static constexpr node_idx NO_CHILD = static_cast<node_idx>(-1);
    static constexpr node_idx ROOT_ID = 0;
+   using Pointers = std::vector<const T*, HugePageAllocator<const T*>>; // huge pages once there are ~250k objects, see HugePages.hpp
 
    enum class Quadrant : uint8_t{
       TopLeft = 0,
@@ -44,17 +49,24 @@ class LinearQuadTree{
    };
 
    std::vector<Node> nodes;      // linear storage for all nodes.
-   std::vector<const T*> data;   // all object pointers stored contiguously by leaves.
+   Pointers data;                // all object pointers stored contiguously by leaves.
+   Pointers scratch;             // ping-pong buffer for the build, same size as 'data'.
+   std::vector<uint8_t> quadrants; // per-object quadrant code, reused by every level of the build.
    Rectangle boundary = {0, 0, 0, 0}; // boundary of the root node   
    count_t capacity = 8;   // objects per quad before subdivision
    count_t max_depth = 5;  // maximum depth allowed
 
-   //helper function to run std::partition and convert the boundary iterator to an index.
-   //partition reorders elements in-place such that elements satisfying the predicate come before those that do not. 
-   //the returned index is the boundary between these two groups.
-   constexpr index_t partition_data(index_t start, index_t end, auto predicate) noexcept{
-      auto iter = std::partition(data.begin() + start, data.begin() + end, predicate);
-      return static_cast<index_t>(iter - data.begin());
+   // Classifies an object into one of the four quadrants around 'center' without branching.
+   // bit 0 is set for the right half, bit 1 for the bottom half, matching the Quadrant enum.
+   static constexpr uint8_t quadrant_of(const T* obj, const Vector2& center) noexcept{
+      const auto right = static_cast<uint8_t>(obj->position.x >= center.x);
+      const auto bottom = static_cast<uint8_t>(obj->position.y >= center.y);
+      return static_cast<uint8_t>(right | (bottom << 1));
+   }
+
+   // Even depths read from 'data', odd depths read from 'scratch'. Each level scatters into the other one.
+   constexpr Pointers& source_for(count_t depth) noexcept{
+      return (depth % 2 == 0) ? data : scratch;
    }
 
    // Helper function to build a child quad. Extracted to reduce the length of the build_tree function.
@@ -66,43 +78,62 @@ class LinearQuadTree{
       return NO_CHILD;
    }
 
-   // Recursively builds the tree by partitioning the 'data'-vector in-place.
-   // 'data' holds all objects, [start, end) is the subrange to work on.
+   // Recursively builds the tree by bucketing the [start, end) subrange into four quadrants.
+   // The objects for this node are read from source_for(depth), and scattered into source_for(depth + 1),
+   // so every level streams its range exactly twice: once to count, once to scatter.
    // 'bound' is the current node's boundary and 'depth' the current recursion depth.
    // Returns the index of the new node in the 'nodes' vector.
    node_idx build_tree(index_t start, index_t end, const Rectangle& bound, count_t depth){
       assert(start < end);
       const auto nodeIndex = static_cast<node_idx>(nodes.size());
       nodes.emplace_back(bound, start);
-      Node& node = nodes.back();
+      const Pointers& src = source_for(depth);
       if(count_t count = end - start;
          count <= capacity || depth >= max_depth){
-         node.data_count = count;
+         nodes[nodeIndex].data_count = count;
+         if(&src != &data){ // leaves always live in 'data', copy back if this level was built in the scratch buffer.
+            std::copy(src.begin() + start, src.begin() + end, data.begin() + start);
+         }
          return nodeIndex;
       }
 
-      // This node will not store any objects; its children will. 
-      // So we subdivide into four quads, and arrange the objects in 'data' based on screen position.
+      // This node will not store any objects; its children will.
+      // So we subdivide into four quads, and bucket the objects based on screen position.
       const Vector2 center = {bound.x + bound.width * 0.5f, bound.y + bound.height * 0.5f};
-      const auto to_the_left = [center](const T* p) noexcept{ return p->position.x < center.x; };
-      const auto to_the_top = [center](const T* p) noexcept{ return p->position.y < center.y; };
-      // time to partition the [start, end) subrange inside the 'data' vector;
-      // 1. Split vertically: objects in top half of 'bounds' will be in the first half of the range, objects in bottom half go in second half   
-      const index_t idx_split_y = partition_data(start, end, to_the_top);
-      // 2. Split top half horizontally: objects in top-left quadrant of 'bounds' go in first quarter of the range, followed by objects in the top-right quadrant
-      const index_t idx_split_x_left = partition_data(start, idx_split_y, to_the_left);
-      // 3. Split bottom half horizontally: objects in bottom-left quadrant go in third quarter of the range, followed by objects in the bottom-right quadrant
-      const index_t idx_split_x_right = partition_data(idx_split_y, end, to_the_left);
+      // 1. Counting pass: compute the 2-bit quadrant code of every object and histogram them.
+      std::array<count_t, 4> offsets{};
+      for(index_t i = start; i < end; ++i){
+         const uint8_t code = quadrant_of(src[i], center);
+         quadrants[i] = code;
+         ++offsets[code];
+      }
+      // 2. Exclusive prefix sum turns the counts into the first index of each bucket.
+      std::array<index_t, 5> bucket{start, 0, 0, 0, end};
+      for(size_t q = 1; q < 4; ++q){
+         bucket[q] = bucket[q - 1] + offsets[q - 1];
+      }
+      // 3. Scatter pass: stable copy into the other buffer, each object lands in its quadrant's bucket.
+      Pointers& dst = source_for(depth + 1);
+      auto cursor = bucket;
+      for(index_t i = start; i < end; ++i){
+         dst[cursor[quadrants[i]]++] = src[i];
+      }
 
       const float x = bound.x;
       const float y = bound.y;
       const float w = bound.width * 0.5f;
       const float h = bound.height * 0.5f;
 
-      node[Quadrant::TopLeft] = build_child_quad(start, idx_split_x_left, {x, y, w, h}, depth);
-      node[Quadrant::TopRight] = build_child_quad(idx_split_x_left, idx_split_y, {x + w, y, w, h}, depth);
-      node[Quadrant::BottomLeft] = build_child_quad(idx_split_y, idx_split_x_right, {x, y + h, w, h}, depth);
-      node[Quadrant::BottomRight] = build_child_quad(idx_split_x_right, end, {x + w, y + h, w, h}, depth);
+      // NOTE: build_child_quad grows 'nodes', so we can't hold a Node& across these calls.
+      const node_idx top_left = build_child_quad(bucket[0], bucket[1], {x, y, w, h}, depth);
+      const node_idx top_right = build_child_quad(bucket[1], bucket[2], {x + w, y, w, h}, depth);
+      const node_idx bottom_left = build_child_quad(bucket[2], bucket[3], {x, y + h, w, h}, depth);
+      const node_idx bottom_right = build_child_quad(bucket[3], bucket[4], {x + w, y + h, w, h}, depth);
+      Node& node = nodes[nodeIndex];
+      node[Quadrant::TopLeft] = top_left;
+      node[Quadrant::TopRight] = top_right;
+      node[Quadrant::BottomLeft] = bottom_left;
+      node[Quadrant::BottomRight] = bottom_right;
       return nodeIndex;
    }
 
@@ -129,26 +160,6 @@ class LinearQuadTree{
       query_range_recursive(node[Quadrant::BottomRight], range, found);
    }
 
-   static Rectangle compute_bounds_of(std::span<const T> objects) noexcept{
-      if(objects.empty()){ return {0, 0, 0, 0}; }
-      auto [min_x, min_y] = objects[0].position;
-      auto [max_x, max_y] = objects[0].position;
-      for(size_t i = 1; i < objects.size(); ++i){
-         const auto& pos = objects[i].position;
-         if(pos.x < min_x) min_x = pos.x;
-         if(pos.x > max_x) max_x = pos.x;
-         if(pos.y < min_y) min_y = pos.y;
-         if(pos.y > max_y) max_y = pos.y;
-      }
-      const float padding = 1.0f; // Add padding to avoid objects exactly at the boundary
-      return {
-          min_x - padding,
-          min_y - padding,
-          (max_x - min_x) + 2 * padding,
-          (max_y - min_y) + 2 * padding
-      };
-   }
-
 public:
    LinearQuadTree() = default;
    LinearQuadTree(const Rectangle& boundary_, std::span<const T> objects, count_t capacity_, count_t max_depth_ = 5)
@@ -172,7 +183,9 @@ public:
          }
       }
       if(data.empty()){ return; }
-      nodes.reserve(data.size() / (capacity / 2)); // just a rough estimate, but might save a few re-allocations.
+      nodes.reserve(data.size() / std::max<count_t>(1, capacity / 2)); // just a rough estimate, but might save a few re-allocations.
+      scratch.resize(data.size());
+      quadrants.resize(data.size());
       build_tree(0, static_cast<index_t>(data.size()), boundary, 0);
    }
 
@@ -190,4 +203,22 @@ public:
    void query_range(const Rectangle& range, std::vector<const T*>& found) const{
       query_range_recursive(ROOT_ID, range, found);
    }
+
+   struct Stats final{
+      size_t nodes = 0;
+      size_t leaves = 0;
+      size_t largest_leaf = 0; // objects in the fullest leaf. Above 'capacity' when max_depth stopped a split.
+      size_t objects = 0;
+   };
+
+   Stats stats() const noexcept{
+      Stats result{nodes.size(), 0, 0, data.size()};
+      for(const auto& node : nodes){
+         if(node.is_leaf()){
+            ++result.leaves;
+            result.largest_leaf = std::max<size_t>(result.largest_leaf, node.data_count);
+         }
+      }
+      return result;
+   }
 };
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "Metrics.hpp"
+#include "HugePages.hpp"
+#include "Parallel.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+// Counts every heap allocation, for the allocations-per-step metric. Every form of operator new is replaced (plain,
+// array, nothrow and aligned), since HugePageAllocator goes through the aligned ones. Whole pages from
+// allocate_pages are counted by HugePages.cpp.
+// An allocation inside a WorkerPool job counts towards the job, whichever thread runs it. Any other one counts
+// towards the thread that made it, so a scrape allocating on the exporter thread doesn't show up in the step.
+// A relaxed increment is all it costs. A step that allocates is a bug worth seeing, not a hot path.
+
+namespace{
+   std::atomic<uint64_t> allocations{0};        // every thread, for the total
+   std::atomic<uint64_t> job_allocations{0};    // inside WorkerPool jobs, on any thread
+   thread_local uint64_t thread_allocations = 0; // this thread, outside of jobs
+
+   void count() noexcept{
+      allocations.fetch_add(1, std::memory_order_relaxed);
+      if(WorkerPool::inside_job()){
+         job_allocations.fetch_add(1, std::memory_order_relaxed);
+      } else{
+         ++thread_allocations;
+      }
+   }
+
+   // Over-aligned memory can't come from malloc, and on Windows has to go back to _aligned_free.
+   void* allocate(std::size_t bytes, std::size_t alignment) noexcept{
+      bytes = bytes ? bytes : 1;
+      if(alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__){
+         return std::malloc(bytes);
+      }
+#if defined(_WIN32)
+      return _aligned_malloc(bytes, alignment);
+#else
+      void* memory = nullptr;
+      return (posix_memalign(&memory, alignment, bytes) == 0) ? memory : nullptr;
+#endif
+   }
+
+   void release(void* memory, std::size_t alignment) noexcept{
+#if defined(_WIN32)
+      if(alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__){
+         _aligned_free(memory);
+         return;
+      }
+#endif
+      (void)alignment;
+      std::free(memory);
+   }
+
+   void* allocate_or_throw(std::size_t bytes, std::size_t alignment){
+      count();
+      while(true){
+         if(void* memory = allocate(bytes, alignment)){
+            return memory;
+         }
+         if(const auto handler = std::get_new_handler()){
+            handler();
+         } else{
+            throw std::bad_alloc{};
+         }
+      }
+   }
+
+   void* allocate_or_null(std::size_t bytes, std::size_t alignment) noexcept{
+      try{
+         return allocate_or_throw(bytes, alignment);
+      } catch(...){ // a new handler may throw too
+         return nullptr;
+      }
+   }
+
+   constexpr std::size_t DEFAULT = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+}
+
+uint64_t allocation_count() noexcept{
+   return allocations.load(std::memory_order_relaxed) + page_allocation_count();
+}
+
+uint64_t step_allocation_count() noexcept{
+   return thread_allocations + job_allocations.load(std::memory_order_relaxed) + page_allocation_count();
+}
+
+void* operator new(std::size_t bytes){ return allocate_or_throw(bytes, DEFAULT); }
+void* operator new[](std::size_t bytes){ return allocate_or_throw(bytes, DEFAULT); }
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept{ return allocate_or_null(bytes, DEFAULT); }
+void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept{ return allocate_or_null(bytes, DEFAULT); }
+void* operator new(std::size_t bytes, std::align_val_t alignment){ return allocate_or_throw(bytes, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t bytes, std::align_val_t alignment){ return allocate_or_throw(bytes, static_cast<std::size_t>(alignment)); }
+void* operator new(std::size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept{ return allocate_or_null(bytes, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept{ return allocate_or_null(bytes, static_cast<std::size_t>(alignment)); }
+
+void operator delete(void* memory) noexcept{ release(memory, DEFAULT); }
+void operator delete[](void* memory) noexcept{ release(memory, DEFAULT); }
+void operator delete(void* memory, std::size_t) noexcept{ release(memory, DEFAULT); }
+void operator delete[](void* memory, std::size_t) noexcept{ release(memory, DEFAULT); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept{ release(memory, DEFAULT); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept{ release(memory, DEFAULT); }
+void operator delete(void* memory, std::align_val_t alignment) noexcept{ release(memory, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* memory, std::align_val_t alignment) noexcept{ release(memory, static_cast<std::size_t>(alignment)); }
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept{ release(memory, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept{ release(memory, static_cast<std::size_t>(alignment)); }
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept{ release(memory, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept{ release(memory, static_cast<std::size_t>(alignment)); }
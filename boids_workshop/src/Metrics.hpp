@@ -0,0 +1,198 @@
+#pragma once
+#include "Socket.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Live telemetry in the Prometheus text format, served over HTTP on localhost by a background thread.
+// The simulation only ever writes relaxed atomics, one writer per metric, so it never waits on a scrape or takes
+// a lock. The exporter thread reads them whenever a scraper asks. A scrape may see a step half recorded (a histogram
+// updated, the step counter not yet), which is fine for monitoring and cheaper than making it consistent.
+
+constexpr uint16_t DEFAULT_METRICS_PORT = 9464;
+
+// Heap allocations since the program started, from any thread. See Metrics.cpp.
+uint64_t allocation_count() noexcept;
+// The part of allocation_count() a step on the calling thread can make: its own allocations, and those inside
+// WorkerPool jobs or of whole pages on any thread. Read it before and after a step.
+uint64_t step_allocation_count() noexcept;
+
+// A Prometheus histogram with fixed bucket bounds. observe() must only be called from one thread at a time.
+template<size_t N>
+class Histogram final{
+   std::array<double, N> bounds; // upper bounds, ascending
+   std::array<std::atomic<uint64_t>, N + 1> buckets{}; // not cumulative. The last one is +Inf
+   std::atomic<double> sum{0.0};
+
+   size_t bucket_of(double value) const noexcept{
+      return static_cast<size_t>(std::ranges::lower_bound(bounds, value) - bounds.begin());
+   }
+
+   // single writer, so a load and a store is all it takes. No read-modify-write on the bus.
+   template<class V>
+   static void add(std::atomic<V>& counter, V amount) noexcept{
+      counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+   }
+
+public:
+   explicit Histogram(const std::array<double, N>& bounds_) noexcept : bounds(bounds_){}
+
+   void observe(double value) noexcept{
+      add(buckets[bucket_of(value)], uint64_t{1});
+      add(sum, value);
+   }
+
+   // Observes 'value(item)' for every item. Tallies locally first, so it's one store per bucket and not per item.
+   template<class Range, class Value>
+   void observe_all(const Range& items, Value value) noexcept{
+      std::array<uint64_t, N + 1> counts{};
+      double total = 0.0;
+      for(const auto& item : items){
+         const double v = value(item);
+         ++counts[bucket_of(v)];
+         total += v;
+      }
+      for(size_t i = 0; i <= N; ++i){
+         if(counts[i]){
+            add(buckets[i], counts[i]);
+         }
+      }
+      add(sum, total);
+   }
+
+   void write(std::string& out, std::string_view name, std::string_view help) const{
+      char line[160];
+      out.append("# HELP ").append(name).append(" ").append(help).append("\n# TYPE ").append(name).append(" histogram\n");
+      uint64_t cumulative = 0;
+      for(size_t i = 0; i <= N; ++i){
+         cumulative += buckets[i].load(std::memory_order_relaxed);
+         if(i < N){
+            std::snprintf(line, sizeof(line), "%.*s_bucket{le=\"%g\"} %llu\n", static_cast<int>(name.size()), name.data(), bounds[i], static_cast<unsigned long long>(cumulative));
+         } else{
+            std::snprintf(line, sizeof(line), "%.*s_bucket{le=\"+Inf\"} %llu\n", static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(cumulative));
+         }
+         out.append(line);
+      }
+      std::snprintf(line, sizeof(line), "%.*s_sum %.9g\n%.*s_count %llu\n", static_cast<int>(name.size()), name.data(), sum.load(std::memory_order_relaxed),
+         static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(cumulative));
+      out.append(line);
+   }
+};
+
+// Everything the simulation reports. It writes, the exporter reads.
+struct SimulationMetrics final{
+   Histogram<10> step_seconds{{0.00025, 0.0005, 0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.066, 0.133}};
+   Histogram<9> neighbours{{0, 1, 2, 4, 8, 16, 32, 64, 128}};
+   std::atomic<uint64_t> steps{0};
+   std::atomic<uint64_t> boids{0};
+   std::atomic<uint64_t> index_nodes{0};
+   std::atomic<uint64_t> index_leaves{0};
+   std::atomic<uint64_t> index_largest_leaf{0};
+   std::atomic<uint64_t> allocations_last_step{0};
+
+   std::string to_prometheus() const{
+      std::string out;
+      out.reserve(4096);
+      step_seconds.write(out, "boids_step_seconds", "Wall time of one simulation step.");
+      neighbours.write(out, "boids_neighbours", "Neighbours each boid steered by, per step.");
+      const auto write = [&](std::string_view name, std::string_view type, std::string_view help, const std::atomic<uint64_t>& value){
+         char line[64];
+         std::snprintf(line, sizeof(line), " %llu\n", static_cast<unsigned long long>(value.load(std::memory_order_relaxed)));
+         out.append("# HELP ").append(name).append(" ").append(help).append("\n# TYPE ").append(name).append(" ").append(type).append("\n")
+            .append(name).append(line);
+      };
+      write("boids_steps_total", "counter", "Simulation steps taken.", steps);
+      write("boids_count", "gauge", "Boids in the simulation.", boids);
+      write("boids_index_nodes", "gauge", "Nodes in the spatial index.", index_nodes);
+      write("boids_index_leaves", "gauge", "Leaves in the spatial index.", index_leaves);
+      write("boids_index_largest_leaf", "gauge", "Objects in the fullest leaf of the spatial index.", index_largest_leaf);
+      write("boids_allocations_per_step", "gauge", "Heap allocations made by the last step.", allocations_last_step);
+      char line[64];
+      std::snprintf(line, sizeof(line), " %llu\n", static_cast<unsigned long long>(allocation_count()));
+      out.append("# HELP boids_allocations_total Heap allocations since start.\n# TYPE boids_allocations_total counter\nboids_allocations_total").append(line);
+      return out;
+   }
+};
+
+// Serves GET /metrics on localhost from its own thread. One request per connection, then it closes.
+class MetricsExporter final{
+   static constexpr auto POLL_INTERVAL = std::chrono::milliseconds(20);
+   static constexpr auto REQUEST_TIMEOUT = std::chrono::seconds(2);
+   static constexpr size_t MAX_REQUEST = 8192;
+
+   const SimulationMetrics& metrics;
+   std::optional<TcpSocket> listener;
+   std::jthread thread; // last, so it stops before the rest goes away
+
+   static bool send_all(TcpSocket& socket, std::string_view text, std::stop_token stop){
+      const auto deadline = std::chrono::steady_clock::now() + REQUEST_TIMEOUT;
+      auto bytes = std::as_bytes(std::span(text.data(), text.size()));
+      while(!bytes.empty()){
+         const auto sent = socket.send(bytes);
+         if(!sent || stop.stop_requested() || std::chrono::steady_clock::now() > deadline){
+            return false;
+         }
+         if(*sent == 0){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+         bytes = bytes.subspan(*sent);
+      }
+      return true;
+   }
+
+   void serve(TcpSocket socket, std::stop_token stop) const{
+      const auto deadline = std::chrono::steady_clock::now() + REQUEST_TIMEOUT;
+      std::string request;
+      std::byte chunk[1024];
+      while(request.find("\r\n\r\n") == std::string::npos){
+         const auto received = socket.receive(chunk);
+         if(!received || request.size() > MAX_REQUEST || stop.stop_requested() || std::chrono::steady_clock::now() > deadline){
+            return;
+         }
+         if(*received == 0){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+         request.append(reinterpret_cast<const char*>(chunk), *received);
+      }
+      const bool found = request.starts_with("GET /metrics ") || request.starts_with("GET / ");
+      const std::string body = found ? metrics.to_prometheus() : std::string("Try /metrics\n");
+      std::string response = found ? "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                   : "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n";
+      response.append("Content-Length: ").append(std::to_string(body.size())).append("\r\nConnection: close\r\n\r\n").append(body);
+      send_all(socket, response, stop);
+   }
+
+   void run(std::stop_token stop){
+      while(!stop.stop_requested()){
+         if(auto socket = listener->accept()){
+            serve(std::move(*socket), stop);
+            continue;
+         }
+         std::this_thread::sleep_for(POLL_INTERVAL);
+      }
+   }
+
+public:
+   MetricsExporter(const SimulationMetrics& metrics_, uint16_t port = DEFAULT_METRICS_PORT)
+      : metrics(metrics_), listener(TcpSocket::listen(port)){
+      if(listener){
+         thread = std::jthread([this](std::stop_token stop){ run(stop); });
+      }
+   }
+   MetricsExporter(const MetricsExporter&) = delete;
+   MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+   bool listening() const noexcept{
+      return listener.has_value();
+   }
+};
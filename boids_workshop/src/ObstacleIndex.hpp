@@ -0,0 +1,65 @@
+#pragma once
+#include "raylib.h"
+#include "LinearQuadTree.hpp"
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <span>
+#include <vector>
+
+// ObstacleIndex answers "which obstacles could a circle touch?", for point queries and for swept circles.
+// Obstacles are indexed by their center in a LinearQuadTree, so every query is grown by the largest obstacle radius.
+// 'O' needs a Vector2 'position' and a float 'radius'. Obstacles are static: build the index once.
+
+template<class O>
+class ObstacleIndex{
+   LinearQuadTree<O> tree;
+   float max_radius = 0.0f;
+
+public:
+   ObstacleIndex(const Rectangle& boundary, std::span<const O> obstacles, uint32_t capacity = 4, uint32_t max_depth = 5)
+      : tree(boundary, obstacles, capacity, max_depth){
+      for(const auto& obs : obstacles){
+         max_radius = std::max(max_radius, obs.radius);
+      }
+   }
+
+   // every obstacle that a circle of 'radius' could touch anywhere on its way from 'from' to 'to'.
+   void query_swept(Vector2 from, Vector2 to, float radius, std::vector<const O*>& found) const{
+      const float reach = radius + max_radius;
+      const float min_x = std::min(from.x, to.x) - reach;
+      const float min_y = std::min(from.y, to.y) - reach;
+      const float max_x = std::max(from.x, to.x) + reach;
+      const float max_y = std::max(from.y, to.y) + reach;
+      tree.query_range({min_x, min_y, max_x - min_x, max_y - min_y}, found);
+   }
+
+   // every obstacle that a circle of 'radius' at 'center' could touch.
+   void query_circle(Vector2 center, float radius, std::vector<const O*>& found) const{
+      query_swept(center, center, radius, found);
+   }
+
+   void render() const noexcept{
+      tree.render();
+   }
+};
+
+// Time of impact of a circle of 'radius' moving from 'from' by 'motion' against a static circle.
+// Returns t in [0, 1], the fraction of 'motion' covered before contact, or nothing if they never touch.
+// A circle that already overlaps reports t = 0 if it is moving further in, and nothing if it is on its way out.
+inline std::optional<float> sweep_circle(Vector2 from, Vector2 motion, float radius, Vector2 center, float obstacle_radius) noexcept{
+   const float reach = radius + obstacle_radius;
+   const Vector2 offset = {from.x - center.x, from.y - center.y};
+   const float a = motion.x * motion.x + motion.y * motion.y;
+   const float b = offset.x * motion.x + offset.y * motion.y;
+   const float c = offset.x * offset.x + offset.y * offset.y - reach * reach;
+   if(c <= 0.0f){
+      return (b < 0.0f) ? std::optional{0.0f} : std::nullopt;
+   }
+   const float discriminant = b * b - a * c;
+   if(a == 0.0f || b >= 0.0f || discriminant < 0.0f){ // not moving, moving away, or passing by
+      return std::nullopt;
+   }
+   const float t = (-b - std::sqrt(discriminant)) / a;
+   return (t <= 1.0f) ? std::optional{t} : std::nullopt;
+}
@@ -0,0 +1,266 @@
+#pragma once
+#include "raylib.h"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+// ObstacleMap turns a black and white level image into obstacles. Dark pixels are walls.
+// At load time we bake a signed distance field: how far every pixel is from the nearest wall, negative inside
+// walls. Obstacle avoidance is then one bilinear sample and a gradient, no matter how complex the level is,
+// instead of a test against every circle primitive.
+// The distance transform is Felzenszwalb & Huttenlocher's exact linear-time algorithm, separable into 1D passes
+// over every column then every row. The passes are independent, so they run in parallel.
+// Loads binary (P5) and ascii (P2) PGM files itself, and everything else (PNG, ...) through raylib.
+// The map itself is CPU data only, so headless runs can load one. Drawing it needs a texture, which the renderer
+// makes with create_texture() once there is a window.
+
+class ObstacleMap final{
+   static constexpr uint8_t WALL_THRESHOLD = 128; // pixels darker than this are walls
+   static constexpr double FAR_AWAY = 1e20;       // "no site" for the distance transform, squared pixels
+
+   std::vector<uint8_t> walls;   // 1 for wall pixels, row-major
+   std::vector<float> distance;  // signed distance to the nearest wall edge in world units, row-major
+   size_t width = 0;
+   size_t height = 0;
+   Vector2 world_size{0, 0};
+   float pixel_size = 1.0f;      // world units per pixel. The image is stretched to the world, with square pixels assumed.
+
+   // 1D squared distance transform of 'f' (0 at sites, FAR_AWAY elsewhere), written to 'd'.
+   // The lower envelope of the parabolas rooted at every site. 'v' and 'z' are scratch of size n and n + 1.
+   static void distance_transform_1d(const std::vector<double>& f, std::vector<double>& d, std::vector<size_t>& v, std::vector<double>& z){
+      const size_t n = f.size();
+      const auto sq = [](double x){ return x * x; };
+      size_t k = 0;
+      v[0] = 0;
+      z[0] = -FAR_AWAY;
+      z[1] = FAR_AWAY;
+      const auto intersection = [&](size_t q, size_t p){ // where the parabolas rooted at 'q' and 'p' cross
+         const auto qd = static_cast<double>(q);
+         const auto pd = static_cast<double>(p);
+         return ((f[q] + sq(qd)) - (f[p] + sq(pd))) / (2.0 * qd - 2.0 * pd);
+      };
+      for(size_t q = 1; q < n; ++q){
+         double s = intersection(q, v[k]);
+         while(s <= z[k]){ // z[0] is minus "infinity", so this stops at k == 0.
+            --k;
+            s = intersection(q, v[k]);
+         }
+         ++k;
+         v[k] = q;
+         z[k] = s;
+         z[k + 1] = FAR_AWAY;
+      }
+      k = 0;
+      for(size_t q = 0; q < n; ++q){
+         while(z[k + 1] < static_cast<double>(q)){
+            ++k;
+         }
+         d[q] = sq(static_cast<double>(q) - static_cast<double>(v[k])) + f[v[k]];
+      }
+   }
+
+   // Squared distance in pixels from every pixel to the nearest pixel where is_site(pixel) is true.
+   template<class Predicate>
+   std::vector<double> squared_distance_to(Predicate is_site) const{
+      std::vector<double> grid(width * height);
+      for(size_t i = 0; i < grid.size(); ++i){
+         grid[i] = is_site(walls[i]) ? 0.0 : FAR_AWAY;
+      }
+      // every worker gets its own scratch, and a range of columns (then rows) that nobody else touches.
+      const auto pass = [&](size_t lines, size_t length, size_t line_stride, size_t step){
+         parallel_for(lines, workers_for(lines, 16), [&](size_t, size_t begin, size_t end){
+            std::vector<double> f(length), d(length), z(length + 1);
+            std::vector<size_t> v(length);
+            for(size_t line = begin; line < end; ++line){
+               for(size_t i = 0; i < length; ++i){
+                  f[i] = grid[line * line_stride + i * step];
+               }
+               distance_transform_1d(f, d, v, z);
+               for(size_t i = 0; i < length; ++i){
+                  grid[line * line_stride + i * step] = d[i];
+               }
+            }
+         });
+      };
+      pass(width, height, 1, width);  // columns
+      pass(height, width, width, 1);  // rows
+      return grid;
+   }
+
+   void bake(){
+      const auto outside = squared_distance_to([](uint8_t wall){ return wall != 0; });
+      const auto inside = squared_distance_to([](uint8_t wall){ return wall == 0; });
+      distance.resize(width * height);
+      for(size_t i = 0; i < distance.size(); ++i){
+         // measured from pixel centers, so move half a pixel to land on the edge between wall and free space.
+         const double pixels = walls[i] ? -(std::sqrt(inside[i]) - 0.5) : std::sqrt(outside[i]) - 0.5;
+         distance[i] = static_cast<float>(pixels) * pixel_size;
+      }
+   }
+
+   static std::optional<std::vector<uint8_t>> load_pgm(const std::string& path, size_t& width, size_t& height){
+      std::ifstream file(path, std::ios::binary);
+      std::string magic;
+      file >> magic;
+      if(magic != "P5" && magic != "P2"){
+         return std::nullopt;
+      }
+      const auto next_number = [&file]() -> size_t{
+         file >> std::ws;
+         while(file.peek() == '#'){ // comments run to the end of the line
+            file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            file >> std::ws;
+         }
+         size_t value = 0;
+         file >> value;
+         return value;
+      };
+      width = next_number();
+      height = next_number();
+      const size_t max_value = next_number();
+      if(!file || width == 0 || height == 0 || max_value == 0 || max_value > 65535){
+         return std::nullopt;
+      }
+      std::vector<uint8_t> gray(width * height);
+      if(magic == "P2"){
+         for(auto& pixel : gray){
+            pixel = static_cast<uint8_t>(next_number() * 255 / max_value);
+         }
+      } else{
+         file.get(); // exactly one whitespace separates the header from the pixels
+         const size_t bytes_per_sample = (max_value > 255) ? 2 : 1;
+         std::vector<unsigned char> raw(gray.size() * bytes_per_sample);
+         file.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()));
+         for(size_t i = 0; i < gray.size(); ++i){
+            const size_t sample = (bytes_per_sample == 2) ? (size_t{raw[2 * i]} << 8) | raw[2 * i + 1] : raw[i];
+            gray[i] = static_cast<uint8_t>(sample * 255 / max_value);
+         }
+      }
+      if(!file){
+         return std::nullopt;
+      }
+      return gray;
+   }
+
+   static std::optional<std::vector<uint8_t>> load_any(const std::string& path, size_t& width, size_t& height){
+      if(path.ends_with(".pgm")){
+         return load_pgm(path, width, height);
+      }
+      Image image = LoadImage(path.c_str());
+      if(image.data == nullptr){
+         return std::nullopt;
+      }
+      ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+      width = static_cast<size_t>(image.width);
+      height = static_cast<size_t>(image.height);
+      const auto* pixels = static_cast<const uint8_t*>(image.data);
+      std::vector<uint8_t> gray(pixels, pixels + width * height);
+      UnloadImage(image);
+      return gray;
+   }
+
+   float pixel_value(const std::vector<float>& grid, float px, float py) const noexcept{
+      const float gx = std::clamp(px - 0.5f, 0.0f, static_cast<float>(width - 1));
+      const float gy = std::clamp(py - 0.5f, 0.0f, static_cast<float>(height - 1));
+      const auto x0 = static_cast<size_t>(gx);
+      const auto y0 = static_cast<size_t>(gy);
+      const size_t x1 = std::min(x0 + 1, width - 1);
+      const size_t y1 = std::min(y0 + 1, height - 1);
+      const float tx = gx - static_cast<float>(x0);
+      const float ty = gy - static_cast<float>(y0);
+      const float top = grid[y0 * width + x0] * (1 - tx) + grid[y0 * width + x1] * tx;
+      const float bottom = grid[y1 * width + x0] * (1 - tx) + grid[y1 * width + x1] * tx;
+      return top * (1 - ty) + bottom * ty;
+   }
+
+   ObstacleMap() = default;
+
+public:
+   // Loads a level mask and bakes its distance field. The image is stretched to cover 'world_size'.
+   // Returns nothing, and logs a warning, if the file can't be read.
+   static std::optional<ObstacleMap> load(const std::string& path, Vector2 world_size){
+      ObstacleMap map;
+      auto gray = load_any(path, map.width, map.height);
+      if(!gray){
+         TraceLog(LOG_WARNING, "OBSTACLEMAP: Failed to load level mask '%s'", path.c_str());
+         return std::nullopt;
+      }
+      map.world_size = world_size;
+      map.pixel_size = world_size.x / static_cast<float>(map.width);
+      map.walls.resize(gray->size());
+      std::ranges::transform(*gray, map.walls.begin(), [](uint8_t g){ return static_cast<uint8_t>(g < WALL_THRESHOLD); });
+      map.bake();
+      TraceLog(LOG_INFO, "OBSTACLEMAP: Loaded '%s' (%zux%zu)", path.c_str(), map.width, map.height);
+      return map;
+   }
+
+   ObstacleMap(const ObstacleMap&) = delete;
+   ObstacleMap& operator=(const ObstacleMap&) = delete;
+   ObstacleMap(ObstacleMap&&) noexcept = default;
+   ObstacleMap& operator=(ObstacleMap&&) noexcept = default;
+
+   // signed distance from 'pos' to the nearest wall, in world units. Negative inside walls.
+   float distance_at(Vector2 pos) const noexcept{
+      return pixel_value(distance, pos.x / world_size.x * static_cast<float>(width), pos.y / world_size.y * static_cast<float>(height));
+   }
+
+   // world units per pixel: walls thinner than this don't exist in the map.
+   float resolution() const noexcept{
+      return pixel_size;
+   }
+
+   // unit vector pointing away from the nearest wall, or zero on a ridge between walls.
+   Vector2 away_from_walls(Vector2 pos) const noexcept{
+      const float step = pixel_size;
+      const float dx = distance_at({pos.x + step, pos.y}) - distance_at({pos.x - step, pos.y});
+      const float dy = distance_at({pos.x, pos.y + step}) - distance_at({pos.x, pos.y - step});
+      const float length = std::sqrt(dx * dx + dy * dy);
+      if(length == 0.0f){
+         return {0, 0};
+      }
+      return {dx / length, dy / length};
+   }
+
+   // The walls as one rectangle per run of wall pixels in a row, in world units. Compact enough to hand to another
+   // process (see --publish), which can draw them without the image.
+   std::vector<Rectangle> wall_runs() const{
+      std::vector<Rectangle> runs;
+      const float pixel_height = world_size.y / static_cast<float>(height);
+      for(size_t y = 0; y < height; ++y){
+         const uint8_t* row = walls.data() + y * width;
+         for(size_t x = 0; x < width;){
+            if(!row[x]){
+               ++x;
+               continue;
+            }
+            const size_t begin = x;
+            while(x < width && row[x]){
+               ++x;
+            }
+            runs.push_back({static_cast<float>(begin) * pixel_size, static_cast<float>(y) * pixel_height,
+               static_cast<float>(x - begin) * pixel_size, pixel_height});
+         }
+      }
+      return runs;
+   }
+
+   // The walls, for render(). Needs a window. The caller owns it and unloads it with UnloadTexture.
+   Texture2D create_texture() const{
+      std::vector<Color> pixels(width * height);
+      for(size_t i = 0; i < pixels.size(); ++i){
+         pixels[i] = walls[i] ? DARKBLUE : BLANK;
+      }
+      Image image{pixels.data(), static_cast<int>(width), static_cast<int>(height), 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+      return LoadTextureFromImage(image); // copies the pixels to the GPU, 'image' doesn't own them.
+   }
+
+   void render(const Texture2D& texture) const noexcept{
+      DrawTexturePro(texture, {0, 0, static_cast<float>(width), static_cast<float>(height)}, {0, 0, world_size.x, world_size.y}, {0, 0}, 0.0f, WHITE);
+   }
+};
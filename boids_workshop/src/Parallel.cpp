@@ -0,0 +1,127 @@
+#include "Parallel.hpp"
+// The OS headers stay in this file. <windows.h> clashes with raylib.h (Rectangle, CloseWindow, DrawText..).
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace{
+   thread_local bool running_chunk = false;
+}
+
+bool pin_current_thread(size_t processor) noexcept{
+#if defined(_WIN32)
+   if(processor >= sizeof(DWORD_PTR) * 8){
+      return false;
+   }
+   return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << processor) != 0;
+#elif defined(__linux__)
+   if(processor >= CPU_SETSIZE){
+      return false;
+   }
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   CPU_SET(processor, &set);
+   return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+   (void)processor;
+   return false;
+#endif
+}
+
+WorkerPool::WorkerPool(){
+   const size_t count = hardware_workers() - 1;
+   starts = std::make_unique<std::atomic<uint64_t>[]>(count);
+   threads.reserve(count);
+   for(size_t w = 1; w <= count; ++w){
+      threads.emplace_back([this, w]{ worker_loop(w); });
+   }
+}
+
+WorkerPool::~WorkerPool(){
+   stopping = true;
+   ++generation;
+   for(size_t t = 0; t < threads.size(); ++t){
+      starts[t].store(generation, std::memory_order_release);
+      starts[t].notify_one();
+   }
+} // jthreads join on destruction
+
+WorkerPool& WorkerPool::instance(){
+   static WorkerPool pool;
+   return pool;
+}
+
+bool WorkerPool::inside_job() noexcept{
+   return running_chunk;
+}
+
+std::exception_ptr WorkerPool::run_chunks(size_t first, Job job_, const void* context_, size_t workers) const noexcept{
+   struct Running final{
+      Running() noexcept{ running_chunk = true; }
+      ~Running() noexcept{ running_chunk = false; }
+   } running;
+   try{
+      for(size_t w = first; w < workers; w += size()){
+         job_(context_, w);
+      }
+   } catch(...){
+      return std::current_exception();
+   }
+   return nullptr;
+}
+
+void WorkerPool::worker_loop(size_t worker){
+   pin_current_thread(worker);
+   std::atomic<uint64_t>& start = starts[worker - 1];
+   uint64_t seen = 0;
+   while(true){
+      start.wait(seen, std::memory_order_acquire);
+      seen = start.load(std::memory_order_acquire); // and with it, the job run() wrote before the store
+      if(stopping){
+         return;
+      }
+      auto error = run_chunks(worker, job, context, job_workers);
+      std::lock_guard lock(mutex);
+      if(error && !failure){
+         failure = std::move(error);
+      }
+      if(--pending == 0){
+         finished.notify_one();
+      }
+   }
+}
+
+void WorkerPool::run(size_t workers, Job job_, const void* context_){
+   std::lock_guard serial(dispatch);
+   const size_t woken = std::min(workers, size()) - 1; // threads 1..woken have chunks, the rest sleep through it
+   job = job_;
+   context = context_;
+   job_workers = workers;
+   ++generation;
+   {
+      std::lock_guard lock(mutex);
+      pending = woken;
+      failure = nullptr;
+   }
+   for(size_t t = 0; t < woken; ++t){
+      starts[t].store(generation, std::memory_order_release);
+      starts[t].notify_one();
+   }
+   auto error = run_chunks(0, job_, context_, workers);
+   {
+      // The threads use 'context', which lives on the caller's stack, so wait for them even when chunk 0 threw.
+      std::unique_lock lock(mutex);
+      finished.wait(lock, [this]{ return pending == 0; });
+      if(!error){
+         error = std::exchange(failure, nullptr);
+      }
+   }
+   if(error){
+      std::rethrow_exception(error);
+   }
+}
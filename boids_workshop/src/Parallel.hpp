@@ -0,0 +1,158 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Minimal fork-join helpers. Work is split into one contiguous chunk per worker, and chunk 'w' is always the same
+// slice of the range for a given count and worker count, so per-worker scratch data (like histograms) lines up
+// between passes. The calling thread runs chunk 0 itself.
+// The workers are a persistent pool, started on first use, and worker 'w' is pinned to logical processor 'w'.
+// Together with the fixed chunking that means a slice of an array is always processed on the same core, so if
+// that core also first touched it (see FirstTouchArray), the memory sits on that core's NUMA node.
+// The calling thread is never pinned: it's the game's main thread, or an engine's own thread through the C API.
+// Chunk 0 goes wherever the OS schedules the caller, and processor 0 is left for it.
+// A job only wakes the threads it has chunks for, so small jobs stay cheap on machines with many cores.
+// An exception thrown by a chunk is rethrown to the caller, once every chunk has finished or given up.
+
+constexpr size_t MIN_ITEMS_PER_WORKER = 4096; // below this, the cost of waking a worker outweighs the work.
+
+inline size_t hardware_workers() noexcept{
+   return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// How many workers are worth using for 'count' items of work.
+inline size_t workers_for(size_t count, size_t min_items_per_worker = MIN_ITEMS_PER_WORKER) noexcept{
+   return std::clamp<size_t>(count / std::max<size_t>(1, min_items_per_worker), 1, hardware_workers());
+}
+
+constexpr size_t chunk_begin(size_t count, size_t workers, size_t worker) noexcept{
+   return count * worker / workers;
+}
+
+// Pins the calling thread to one logical processor. Returns false if the OS refused, or pinning isn't supported.
+// On Windows this is limited to the first 64 logical processors (one processor group).
+bool pin_current_thread(size_t processor) noexcept;
+
+class WorkerPool final{
+public:
+   using Job = void(*)(const void* context, size_t worker);
+
+private:
+   std::unique_ptr<std::atomic<uint64_t>[]> starts; // per pool thread, the generation of the last job it was woken for
+   std::vector<std::jthread> threads;  // worker 'w' is threads[w - 1], the caller is worker 0. Joined before 'starts' goes.
+   std::mutex dispatch;                // one job at a time
+   // Written by run() before it wakes the threads, and only read by woken threads until they are done.
+   Job job = nullptr;
+   const void* context = nullptr;
+   size_t job_workers = 0;             // chunks in the current job
+   uint64_t generation = 0;            // bumped for every job, so the threads can tell a new one from a spurious wake
+   bool stopping = false;
+   std::mutex mutex;                   // guards everything below
+   std::condition_variable finished;
+   size_t pending = 0;                 // woken threads that haven't finished the current job
+   std::exception_ptr failure;         // the first exception a pool thread's chunk threw in the current job
+
+   WorkerPool();
+   void worker_loop(size_t worker);
+   std::exception_ptr run_chunks(size_t first, Job job_, const void* context_, size_t workers) const noexcept;
+
+public:
+   ~WorkerPool();
+   WorkerPool(const WorkerPool&) = delete;
+   WorkerPool& operator=(const WorkerPool&) = delete;
+
+   // The pool is started by the first thread to use it. That thread's affinity is left alone.
+   static WorkerPool& instance();
+
+   // true on a thread that is currently running a chunk. Nested jobs run serially instead of deadlocking.
+   static bool inside_job() noexcept;
+
+   size_t size() const noexcept{
+      return threads.size() + 1;
+   }
+
+   // Calls job(context, w) for every w in [0, workers) and returns when all calls are done.
+   // With more chunks than threads, thread 't' runs chunks t, t + size(), t + 2 * size()...
+   // If a chunk throws, the thread running it skips its remaining chunks and the exception is rethrown here.
+   void run(size_t workers, Job job_, const void* context_);
+};
+
+// Calls fn(worker, begin, end) for every chunk of [0, count), and returns when all of them are done.
+template<class Fn>
+void parallel_for(size_t count, size_t workers, Fn&& fn){
+   if(workers <= 1 || WorkerPool::inside_job()){
+      fn(size_t{0}, size_t{0}, count);
+      return;
+   }
+   struct Context final{
+      std::remove_reference_t<Fn>* fn;
+      size_t count;
+      size_t workers;
+   };
+   const Context context{std::addressof(fn), count, workers};
+   WorkerPool::instance().run(workers, [](const void* erased, size_t w){
+      const auto& c = *static_cast<const Context*>(erased);
+      (*c.fn)(w, chunk_begin(c.count, c.workers, w), chunk_begin(c.count, c.workers, w + 1));
+   }, &context);
+}
+
+// A fixed-size array whose elements are constructed (and destroyed) by parallel_for, so each page is first touched,
+// and on a NUMA system allocated, by the worker that processes it. That only holds as long as the loops over the
+// array use the same chunking: its size and workers_for(size()). With huge pages it holds per 2 MiB page, not per
+// chunk, see HugePages.hpp.
+// 'Allocator' only provides the memory, see HugePageAllocator. Pages it hands out untouched stay untouched until here.
+template<class T, class Allocator = std::allocator<T>>
+class FirstTouchArray final{
+   using Traits = std::allocator_traits<Allocator>;
+
+   Allocator allocator;
+   T* items = nullptr;
+   size_t count = 0;
+
+public:
+   FirstTouchArray() = default;
+   explicit FirstTouchArray(size_t count_, const Allocator& allocator_ = Allocator())
+      : allocator(allocator_), items(Traits::allocate(allocator, count_)), count(count_){
+      parallel_for(count, workers_for(count), [this](size_t, size_t begin, size_t end){
+         std::uninitialized_value_construct(items + begin, items + end);
+      });
+   }
+   FirstTouchArray(const FirstTouchArray&) = delete;
+   FirstTouchArray& operator=(const FirstTouchArray&) = delete;
+   FirstTouchArray(FirstTouchArray&& other) noexcept
+      : allocator(std::move(other.allocator)), items(std::exchange(other.items, nullptr)), count(std::exchange(other.count, 0)){}
+   FirstTouchArray& operator=(FirstTouchArray&& other) noexcept{
+      std::swap(allocator, other.allocator);
+      std::swap(items, other.items);
+      std::swap(count, other.count);
+      return *this;
+   }
+   ~FirstTouchArray() noexcept{
+      if(!items){
+         return;
+      }
+      parallel_for(count, workers_for(count), [this](size_t, size_t begin, size_t end){
+         std::destroy(items + begin, items + end);
+      });
+      Traits::deallocate(allocator, items, count);
+   }
+
+   T* data() noexcept{ return items; }
+   const T* data() const noexcept{ return items; }
+   size_t size() const noexcept{ return count; }
+   bool empty() const noexcept{ return count == 0; }
+   T* begin() noexcept{ return items; }
+   T* end() noexcept{ return items + count; }
+   const T* begin() const noexcept{ return items; }
+   const T* end() const noexcept{ return items + count; }
+   T& operator[](size_t i) noexcept{ return items[i]; }
+   const T& operator[](size_t i) const noexcept{ return items[i]; }
+};
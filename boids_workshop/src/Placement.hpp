@@ -0,0 +1,178 @@
+#pragma once
+#include "raylib.h"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Initial placement of a flock, in parallel. Every random number is a pure function of (seed, index, stream), a
+// counter-based RNG, so there is no generator state to share or split between workers: boid 'i' gets the same
+// position no matter how many threads run, or in what order. The per-boid loops are plain arithmetic on the index,
+// which is what the vectoriser wants to see.
+//  Uniform:          anywhere in the area.
+//  GaussianClusters: normally distributed around a handful of random centers.
+//  PoissonDisk:      blue noise, no two boids closer than a minimum distance. Dart throwing on a grid where a cell
+//                    holds at most one sample. Cells three apart can't conflict, so the grid is coloured in 3x3
+//                    phases and all cells of a phase are filled in parallel.
+
+enum class Distribution : uint8_t{ Uniform, GaussianClusters, PoissonDisk };
+
+constexpr std::string_view to_string(Distribution distribution) noexcept{
+   switch(distribution){
+   case Distribution::Uniform: return "uniform";
+   case Distribution::GaussianClusters: return "gaussian clusters";
+   case Distribution::PoissonDisk: return "poisson disk";
+   }
+   return "unknown";
+}
+
+struct Placement final{
+   Distribution distribution = Distribution::Uniform;
+   uint32_t seed = 0;
+   uint32_t cluster_count = 5;     // GaussianClusters: number of centers
+   float cluster_spread = 60.0f;   // GaussianClusters: standard deviation around a center
+   float min_distance = 0.0f;      // PoissonDisk: 0 picks the largest distance that still fits every boid
+};
+
+namespace placement_detail{
+   enum Stream : uint32_t{ POSITION_X, POSITION_Y, HEADING, CLUSTER, GAUSS_RADIUS, GAUSS_ANGLE, DART_X, DART_Y, WANDER };
+   constexpr uint32_t DART_ATTEMPTS = 16;  // per cell and phase. More fills the area more densely.
+   constexpr float TWO_PI = 6.28318530718f;
+
+   // lowbias32 by Chris Wellons: a cheap 32 bit integer hash with good avalanche.
+   constexpr uint32_t mix(uint32_t x) noexcept{
+      x ^= x >> 16;
+      x *= 0x7feb352dU;
+      x ^= x >> 15;
+      x *= 0x846ca68bU;
+      x ^= x >> 16;
+      return x;
+   }
+
+   constexpr uint32_t random_bits(uint32_t seed, uint32_t index, uint32_t stream) noexcept{
+      return mix(mix(index * 0x9e3779b9U + seed) ^ (stream * 0x85ebca6bU));
+   }
+
+   // uniform in [0, 1), from the top 24 bits so every value is exact in a float.
+   constexpr float random01(uint32_t seed, uint32_t index, uint32_t stream) noexcept{
+      return static_cast<float>(random_bits(seed, index, stream) >> 8) * (1.0f / 16777216.0f);
+   }
+
+   inline Vector2 uniform_in(const Rectangle& area, uint32_t seed, uint32_t index) noexcept{
+      return {area.x + area.width * random01(seed, index, POSITION_X), area.y + area.height * random01(seed, index, POSITION_Y)};
+   }
+
+   inline Vector2 gaussian_in(const Rectangle& area, const Placement& config, uint32_t index) noexcept{
+      const uint32_t clusters = std::max(1U, config.cluster_count);
+      const uint32_t cluster = random_bits(config.seed, index, CLUSTER) % clusters;
+      const Vector2 center = uniform_in(area, config.seed ^ 0x5bd1e995U, cluster); // a different seed, so centers aren't boids
+      // Box-Muller. 1 - u keeps the log away from zero.
+      const float radius = config.cluster_spread * std::sqrt(-2.0f * std::log(1.0f - random01(config.seed, index, GAUSS_RADIUS)));
+      const float angle = TWO_PI * random01(config.seed, index, GAUSS_ANGLE);
+      return {
+         std::clamp(center.x + radius * std::cos(angle), area.x, area.x + area.width),
+         std::clamp(center.y + radius * std::sin(angle), area.y, area.y + area.height)
+      };
+   }
+
+   // At most one point per cell of a grid over 'area', no two closer than 'min_distance', in row-major cell order.
+   inline std::vector<Vector2> poisson_disk(const Rectangle& area, float min_distance, uint32_t seed){
+      const float cell_size = min_distance / std::sqrt(2.0f); // one sample per cell can't violate the distance
+      const auto columns = std::max<size_t>(1, static_cast<size_t>(std::ceil(area.width / cell_size)));
+      const auto rows = std::max<size_t>(1, static_cast<size_t>(std::ceil(area.height / cell_size)));
+      std::vector<Vector2> cells(columns * rows);
+      std::vector<uint8_t> filled(columns * rows, 0);
+      const float min_distance_sq = min_distance * min_distance;
+      const auto fits = [&](Vector2 p, size_t column, size_t row){
+         // the distance spans less than two cells, so the 5x5 neighbourhood covers every possible conflict.
+         for(size_t y = (row < 2 ? 0 : row - 2); y <= std::min(rows - 1, row + 2); ++y){
+            for(size_t x = (column < 2 ? 0 : column - 2); x <= std::min(columns - 1, column + 2); ++x){
+               const size_t cell = y * columns + x;
+               if(!filled[cell]){
+                  continue;
+               }
+               const float dx = cells[cell].x - p.x;
+               const float dy = cells[cell].y - p.y;
+               if(dx * dx + dy * dy < min_distance_sq){
+                  return false;
+               }
+            }
+         }
+         return true;
+      };
+      for(size_t phase = 0; phase < 9; ++phase){
+         const size_t phase_x = phase % 3;
+         const size_t phase_y = phase / 3;
+         const size_t phase_rows = (rows > phase_y) ? (rows - phase_y + 2) / 3 : 0;
+         const size_t workers = std::min(workers_for(phase_rows * columns / 3), std::max<size_t>(1, phase_rows));
+         parallel_for(phase_rows, workers, [&](size_t, size_t begin, size_t end){
+            for(size_t r = begin; r < end; ++r){
+               const size_t row = phase_y + r * 3;
+               for(size_t column = phase_x; column < columns; column += 3){
+                  const size_t cell = row * columns + column;
+                  for(uint32_t attempt = 0; attempt < DART_ATTEMPTS; ++attempt){
+                     const auto dart = static_cast<uint32_t>(cell * DART_ATTEMPTS + attempt);
+                     const Vector2 p = {
+                        area.x + std::min(area.width, (static_cast<float>(column) + random01(seed, dart, DART_X)) * cell_size),
+                        area.y + std::min(area.height, (static_cast<float>(row) + random01(seed, dart, DART_Y)) * cell_size)
+                     };
+                     if(fits(p, column, row)){
+                        cells[cell] = p;
+                        filled[cell] = 1;
+                        break;
+                     }
+                  }
+               }
+            }
+         });
+      }
+      std::vector<Vector2> samples;
+      samples.reserve(cells.size());
+      for(size_t cell = 0; cell < cells.size(); ++cell){
+         if(filled[cell]){
+            samples.push_back(cells[cell]);
+         }
+      }
+      return samples;
+   }
+}
+
+// Gives every boid a position in 'area' and a random heading at 'speed'. 'T' needs Vector2 'position' and 'velocity'.
+// Boids are written in place and in parallel, so they can be default constructed cheaply beforehand.
+template<class T>
+void place(std::span<T> boids, const Rectangle& area, float speed, const Placement& config){
+   using namespace placement_detail;
+   const size_t count = boids.size();
+   std::vector<Vector2> samples;
+   if(config.distribution == Distribution::PoissonDisk && count > 0){
+      // the darts above fill about one point per 1.45 r^2 of area. Aim a bit denser than needed, then thin.
+      const float fitting_distance = std::sqrt(area.width * area.height / (static_cast<float>(count) * 1.6f));
+      const float min_distance = (config.min_distance > 0.0f) ? config.min_distance : fitting_distance;
+      samples = poisson_disk(area, min_distance, config.seed);
+   }
+   parallel_for(count, workers_for(count), [&](size_t, size_t begin, size_t end){
+      for(size_t i = begin; i < end; ++i){
+         const auto index = static_cast<uint32_t>(i);
+         Vector2 position{};
+         switch(config.distribution){
+         case Distribution::Uniform:
+            position = uniform_in(area, config.seed, index);
+            break;
+         case Distribution::GaussianClusters:
+            position = gaussian_in(area, config, index);
+            break;
+         case Distribution::PoissonDisk:
+            // evenly spaced picks from the row-major samples keep the thinning spread over the whole area.
+            // With fewer samples than boids (a large min_distance), the rest are placed uniformly.
+            position = (count <= samples.size()) ? samples[i * samples.size() / count] : (i < samples.size() ? samples[i] : uniform_in(area, config.seed, index));
+            break;
+         }
+         const float heading = TWO_PI * random01(config.seed, index, HEADING);
+         boids[i].position = position;
+         boids[i].velocity = {std::cos(heading) * speed, std::sin(heading) * speed};
+      }
+   });
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include "raylib.h"
+#include "SpatialIndex.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+// PyramidQuadTree is a complete (implicit) quadtree: every level 'd' is a dense 2^d x 2^d grid over the boundary.
+// Objects are counting-sorted by the Morton code of their cell on the finest level, so every cell on every
+// level covers exactly one contiguous range of the 'data' vector. There are no nodes and no child indices:
+// a cell is addressed by (level, x, y), its children are (level + 1, 2x + i, 2y + j) and its objects are
+// found by two lookups into a single prefix sum.
+// Compared to LinearQuadTree the metadata is a fixed 4^max_depth + 1 integers, and the build is two linear
+// passes no matter how the objects are distributed. It is best suited for dense worlds with a small max_depth.
+
+template<class T>
+class PyramidQuadTree{
+   using index_t = uint32_t; // index to an object in the 'data' vector
+   using count_t = uint32_t; // number of objects in a cell, or a cell coordinate
+   using morton_t = uint32_t; // interleaved cell coordinates, x in the even bits and y in the odd bits
+   static constexpr count_t MAX_SUPPORTED_DEPTH = 15; // two bits per level must fit in a morton_t
+
+   std::vector<const T*> data;     // all object pointers, sorted by the Morton code of their finest cell.
+   std::vector<const T*> scratch;  // scatter target for the counting sort, swapped with 'data' after each build.
+   std::vector<morton_t> codes;    // finest-level Morton code per object, cached between the two build passes.
+   std::vector<index_t> offsets;   // exclusive prefix sum of cell counts on the finest level, 4^max_depth + 1 entries.
+   std::vector<index_t> cursor;    // per-cell write position during the scatter pass.
+   Rectangle boundary = {0, 0, 0, 0}; // boundary of the level 0 cell
+   count_t capacity = 8;   // objects per cell before a query descends to the next level
+   count_t max_depth = 5;  // the finest level
+
+   // Spreads the lower 16 bits of 'v' out to the even bits of the result.
+   static constexpr morton_t part_1_by_1(morton_t v) noexcept{
+      v &= 0x0000ffff;
+      v = (v | (v << 8)) & 0x00ff00ff;
+      v = (v | (v << 4)) & 0x0f0f0f0f;
+      v = (v | (v << 2)) & 0x33333333;
+      v = (v | (v << 1)) & 0x55555555;
+      return v;
+   }
+
+   static constexpr morton_t morton(count_t x, count_t y) noexcept{
+      return part_1_by_1(x) | (part_1_by_1(y) << 1);
+   }
+
+   constexpr count_t cells_per_side(count_t level) const noexcept{
+      return count_t{1} << level;
+   }
+
+   // A cell on 'level' covers 4^(max_depth - level) consecutive cells of the finest level,
+   // so the offsets of every coarser level are just the finest prefix sum sampled with a stride.
+   constexpr std::pair<index_t, index_t> cell_range(count_t level, count_t x, count_t y) const noexcept{
+      const count_t shift = 2 * (max_depth - level);
+      const morton_t first = morton(x, y) << shift;
+      const morton_t last = (morton(x, y) + 1) << shift;
+      return {offsets[first], offsets[last]};
+   }
+
+   constexpr Rectangle cell_bounds(count_t level, count_t x, count_t y) const noexcept{
+      const float w = boundary.width / static_cast<float>(cells_per_side(level));
+      const float h = boundary.height / static_cast<float>(cells_per_side(level));
+      return {boundary.x + static_cast<float>(x) * w, boundary.y + static_cast<float>(y) * h, w, h};
+   }
+
+   constexpr morton_t finest_cell_of(const T* obj) const noexcept{
+      const count_t side = cells_per_side(max_depth);
+      const float fx = (obj->position.x - boundary.x) / boundary.width * static_cast<float>(side);
+      const float fy = (obj->position.y - boundary.y) / boundary.height * static_cast<float>(side);
+      const auto x = static_cast<count_t>(std::clamp(fx, 0.0f, static_cast<float>(side - 1)));
+      const auto y = static_cast<count_t>(std::clamp(fy, 0.0f, static_cast<float>(side - 1)));
+      return morton(x, y);
+   }
+
+   static constexpr bool contains(const Rectangle& outer, const Rectangle& inner) noexcept{
+      return inner.x >= outer.x && inner.y >= outer.y
+         && inner.x + inner.width <= outer.x + outer.width
+         && inner.y + inner.height <= outer.y + outer.height;
+   }
+
+   void query_cell(count_t level, count_t x, count_t y, const Rectangle& range, std::vector<const T*>& found) const{
+      const auto [begin, end] = cell_range(level, x, y);
+      if(begin == end){
+         return;
+      }
+      const Rectangle bound = cell_bounds(level, x, y);
+      if(!CheckCollisionRecs(bound, range)){
+         return;
+      }
+      if(contains(range, bound)){ // every object in the cell is inside the range, no need to test them.
+         found.insert(found.end(), data.begin() + begin, data.begin() + end);
+         return;
+      }
+      if(end - begin <= capacity || level >= max_depth){
+         for(index_t i = begin; i < end; ++i){
+            if(CheckCollisionPointRec(data[i]->position, range)){
+               found.push_back(data[i]);
+            }
+         }
+         return;
+      }
+      query_cell(level + 1, 2 * x, 2 * y, range, found);
+      query_cell(level + 1, 2 * x + 1, 2 * y, range, found);
+      query_cell(level + 1, 2 * x, 2 * y + 1, range, found);
+      query_cell(level + 1, 2 * x + 1, 2 * y + 1, range, found);
+   }
+
+   void render_cell(count_t level, count_t x, count_t y) const noexcept{
+      const auto [begin, end] = cell_range(level, x, y);
+      if(begin == end){
+         return;
+      }
+      DrawRectangleLinesEx(cell_bounds(level, x, y), 1, GREEN);
+      if(end - begin <= capacity || level >= max_depth){
+         return;
+      }
+      render_cell(level + 1, 2 * x, 2 * y);
+      render_cell(level + 1, 2 * x + 1, 2 * y);
+      render_cell(level + 1, 2 * x, 2 * y + 1);
+      render_cell(level + 1, 2 * x + 1, 2 * y + 1);
+   }
+
+public:
+   PyramidQuadTree() = default;
+   PyramidQuadTree(const Rectangle& boundary_, std::span<const T> objects, count_t capacity_, count_t max_depth_ = 5)
+      : boundary(boundary_), capacity(capacity_), max_depth(max_depth_){
+      assert(capacity > 0);
+      assert(max_depth > 0 && max_depth <= MAX_SUPPORTED_DEPTH);
+      rebuild(objects);
+   }
+
+   PyramidQuadTree(std::span<const T> objects, count_t capacity_, count_t max_depth_ = 5)
+      : PyramidQuadTree(compute_bounds_of(objects), objects, capacity_, max_depth_){}
+
+   void rebuild(std::span<const T> objects){
+      data.clear();
+      offsets.assign((size_t{1} << (2 * max_depth)) + 1, index_t{0}); // sized here too, so a default constructed tree can rebuild
+      if(objects.empty()){ return; }
+      data.reserve(objects.size());
+      for(auto& obj : objects){ //NOTE: if objects are guarantueed to be within the bounds, you can skip this filtering!
+         if(CheckCollisionPointRec(obj.position, boundary)){
+            data.push_back(std::addressof(obj));
+         }
+      }
+      if(data.empty()){ return; }
+      // 1. Counting pass: histogram the finest cells. offsets[code + 1] counts cell 'code'.
+      codes.resize(data.size());
+      for(size_t i = 0; i < data.size(); ++i){
+         codes[i] = finest_cell_of(data[i]);
+         ++offsets[codes[i] + 1];
+      }
+      // 2. Inclusive scan over the shifted counts gives the exclusive prefix sum: offsets[code] is where cell 'code' starts.
+      for(size_t i = 1; i < offsets.size(); ++i){
+         offsets[i] += offsets[i - 1];
+      }
+      // 3. Scatter pass: 'cursor' is a copy of the cell starts that we advance as each cell fills up.
+      scratch.resize(data.size());
+      cursor.assign(offsets.begin(), offsets.end() - 1);
+      for(size_t i = 0; i < data.size(); ++i){
+         scratch[cursor[codes[i]]++] = data[i];
+      }
+      std::swap(data, scratch);
+   }
+
+   void rebuild_and_fit_to(std::span<const T> objects){
+      boundary = compute_bounds_of(objects);
+      rebuild(objects);
+   }
+
+   void render() const noexcept{
+      if(data.empty()){ return; }
+      render_cell(0, 0, 0);
+   }
+
+   void query_range(const Rectangle& range, std::vector<const T*>& found) const{
+      if(data.empty()){ return; }
+      query_cell(0, 0, 0, range, found);
+   }
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "raylib.h"
+#include "Simulation.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// What the renderer needs of each boid, and nothing else: where it is, which way it's heading and what colour it is.
+// The step writes a boid's packet right after integrating it, while the boid is still in cache, so the heading
+// (a length and a division) is worked out once per step instead of once per draw, and drawing never touches the
+// Boids themselves with their velocity, neighbour list and wander state.
+// Each field is its own array (structure of arrays). The whole thing is 17 bytes per boid, so handing a copy to a
+// render thread or another buffer is cheap.
+
+class RenderPackets final{
+   std::vector<float> x;
+   std::vector<float> y;
+   std::vector<float> heading_cos;
+   std::vector<float> heading_sin;
+   std::vector<uint8_t> colour; // into the palette given to render()
+
+public:
+   explicit RenderPackets(size_t count = 0){
+      resize(count);
+   }
+
+   void resize(size_t count){
+      x.resize(count);
+      y.resize(count);
+      heading_cos.resize(count, 1.0f);
+      heading_sin.resize(count, 0.0f);
+      colour.resize(count, 0);
+   }
+
+   size_t size() const noexcept{
+      return x.size();
+   }
+
+   // A boid standing still keeps the heading it had.
+   void write(size_t i, Vector2 position, Vector2 velocity, uint8_t colour_index = 0) noexcept{
+      x[i] = position.x;
+      y[i] = position.y;
+      const float speed = Vector2Length(velocity);
+      if(speed > 0.0f){
+         heading_cos[i] = velocity.x / speed;
+         heading_sin[i] = velocity.y / speed;
+      }
+      colour[i] = colour_index;
+   }
+
+   void render(float size, std::span<const Color> palette) const noexcept{
+      if(palette.empty()){
+         return;
+      }
+      for(size_t i = 0; i < x.size(); ++i){
+         const Color color = colour[i] < palette.size() ? palette[colour[i]] : palette.front();
+         draw_boid({x[i], y[i]}, {heading_cos[i], heading_sin[i]}, size, color);
+      }
+   }
+};
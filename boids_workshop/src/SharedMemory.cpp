@@ -0,0 +1,148 @@
+#include "SharedMemory.hpp"
+// The OS headers stay in this file. <windows.h> clashes with raylib.h (Rectangle, CloseWindow, DrawText..).
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+namespace{
+   // the Local\ namespace is per session, and doesn't need the "Create global objects" privilege.
+   std::string native_name(const std::string& name){
+      return "Local\\" + name;
+   }
+}
+
+SharedMemory::~SharedMemory() noexcept{
+   if(memory){
+      UnmapViewOfFile(memory);
+   }
+   if(handle){
+      CloseHandle(reinterpret_cast<HANDLE>(handle)); // the mapping goes away with its last handle
+   }
+}
+
+std::optional<SharedMemory> SharedMemory::create(const std::string& name, size_t bytes){
+   const auto size = static_cast<uint64_t>(bytes);
+   HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+      static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), native_name(name).c_str());
+   if(!mapping){
+      return std::nullopt;
+   }
+   if(GetLastError() == ERROR_ALREADY_EXISTS){ // we were handed the existing mapping
+      CloseHandle(mapping);
+      return std::nullopt;
+   }
+   void* memory = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, bytes);
+   if(!memory){
+      CloseHandle(mapping);
+      return std::nullopt;
+   }
+   return SharedMemory(memory, bytes, reinterpret_cast<uintptr_t>(mapping), name);
+}
+
+std::optional<SharedMemory> SharedMemory::open(const std::string& name){
+   HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, native_name(name).c_str());
+   if(!mapping){
+      return std::nullopt;
+   }
+   void* memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   MEMORY_BASIC_INFORMATION info{};
+   if(!memory || VirtualQuery(memory, &info, sizeof(info)) == 0){
+      if(memory){
+         UnmapViewOfFile(memory);
+      }
+      CloseHandle(mapping);
+      return std::nullopt;
+   }
+   return SharedMemory(memory, info.RegionSize, reinterpret_cast<uintptr_t>(mapping), {});
+}
+
+bool SharedMemory::remove(const std::string&) noexcept{
+   return false;
+}
+
+uint32_t current_process_id() noexcept{
+   return GetCurrentProcessId();
+}
+
+bool process_alive(uint32_t pid) noexcept{
+   HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+   if(!process){
+      return GetLastError() == ERROR_ACCESS_DENIED; // it exists, it just isn't ours
+   }
+   const bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+   CloseHandle(process);
+   return running;
+}
+#else
+namespace{
+   // POSIX names are a single path component that starts with a slash.
+   std::string native_name(const std::string& name){
+      return "/" + name;
+   }
+}
+
+SharedMemory::~SharedMemory() noexcept{
+   if(memory){
+      munmap(memory, bytes);
+   }
+   if(!name.empty()){
+      shm_unlink(native_name(name).c_str()); // readers keep their mappings, new ones can't open it
+   }
+}
+
+std::optional<SharedMemory> SharedMemory::create(const std::string& name, size_t bytes){
+   const std::string path = native_name(name);
+   const int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+   if(fd == -1){
+      return std::nullopt;
+   }
+   void* memory = (ftruncate(fd, static_cast<off_t>(bytes)) == 0)
+      ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+   close(fd); // the mapping keeps the memory alive
+   if(memory == MAP_FAILED){
+      shm_unlink(path.c_str());
+      return std::nullopt;
+   }
+   return SharedMemory(memory, bytes, 0, name);
+}
+
+std::optional<SharedMemory> SharedMemory::open(const std::string& name){
+   const int fd = shm_open(native_name(name).c_str(), O_RDONLY, 0);
+   if(fd == -1){
+      return std::nullopt;
+   }
+   struct stat info{};
+   void* memory = (fstat(fd, &info) == 0 && info.st_size > 0)
+      ? mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+   close(fd);
+   if(memory == MAP_FAILED){
+      return std::nullopt;
+   }
+   return SharedMemory(memory, static_cast<size_t>(info.st_size), 0, {});
+}
+
+bool SharedMemory::remove(const std::string& name) noexcept{
+   return shm_unlink(native_name(name).c_str()) == 0;
+}
+
+uint32_t current_process_id() noexcept{
+   return static_cast<uint32_t>(getpid());
+}
+
+bool process_alive(uint32_t pid) noexcept{
+   if(pid == 0){
+      return false;
+   }
+   return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM; // EPERM: it exists, it just isn't ours
+}
+#endif
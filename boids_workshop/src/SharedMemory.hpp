@@ -0,0 +1,255 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Named shared memory, so a simulation and its renderers can run in separate processes.
+// The platform code (shm_open / CreateFileMapping) lives in SharedMemory.cpp, away from raylib.h.
+// The creator owns the name: it is removed when the creator's mapping is destroyed. Others map it read-only.
+// A name can only be created once. One left behind by a crashed creator has to be remove()d first.
+
+class SharedMemory final{
+   void* memory = nullptr;
+   size_t bytes = 0;
+   uintptr_t handle = 0;  // the mapping object on Windows, unused elsewhere
+   std::string name;      // set only for the creator, which unlinks it
+
+   SharedMemory(void* memory_, size_t bytes_, uintptr_t handle_, std::string name_) noexcept
+      : memory(memory_), bytes(bytes_), handle(handle_), name(std::move(name_)){}
+
+public:
+   SharedMemory(const SharedMemory&) = delete;
+   SharedMemory& operator=(const SharedMemory&) = delete;
+   SharedMemory(SharedMemory&& other) noexcept
+      : memory(std::exchange(other.memory, nullptr)), bytes(std::exchange(other.bytes, 0)),
+      handle(std::exchange(other.handle, 0)), name(std::move(other.name)){
+      other.name.clear();
+   }
+   SharedMemory& operator=(SharedMemory&& other) noexcept{
+      std::swap(memory, other.memory);
+      std::swap(bytes, other.bytes);
+      std::swap(handle, other.handle);
+      std::swap(name, other.name);
+      return *this;
+   }
+   ~SharedMemory() noexcept;
+
+   // Creates 'name', zero filled and writable. Nothing if it already exists.
+   static std::optional<SharedMemory> create(const std::string& name, size_t bytes);
+   // Maps an existing 'name' read-only. Nothing if no process has created it.
+   static std::optional<SharedMemory> open(const std::string& name);
+   // Removes a name whose creator is gone, so it can be created again. Existing mappings stay valid.
+   // On Windows a name lives exactly as long as somebody has it mapped, so there is nothing to remove: returns false.
+   static bool remove(const std::string& name) noexcept;
+
+   void* data() const noexcept{
+      return memory;
+   }
+   size_t size() const noexcept{
+      return bytes;
+   }
+};
+
+uint32_t current_process_id() noexcept;
+// false once the process has exited. Also false for an id that was never used.
+bool process_alive(uint32_t pid) noexcept;
+
+// Triple buffered frames of 'T' in shared memory. One writer (the simulation) publishes, any number of readers
+// (renderers) read the newest frame in place, without copying and without ever blocking the writer.
+// The writer always fills the oldest of the three slots, so a reader that picked up the newest one has two whole
+// publishes before it can be overwritten. Readers can't write to their read-only mapping to claim a slot, so every
+// slot carries a sequence number, seqlock style: odd while it's written. A reader checks it again when done, and a
+// frame that changed underneath it (a reader stalled for two simulation steps) is reported as torn.
+// The header records the writer's process id. A second writer for the same name fails while the first is alive,
+// and only takes over the name once that process is gone.
+namespace shared_frames_detail{
+   constexpr uint64_t MAGIC = 0x324d485344494f42; // "BOIDSHM2"
+   constexpr uint32_t NONE = ~uint32_t{0};
+   constexpr size_t SLOTS = 3;
+   constexpr size_t ALIGNMENT = 64; // slots don't share cache lines
+
+   struct Slot final{
+      std::atomic<uint64_t> sequence;
+      uint64_t frame;
+      uint32_t count;
+   };
+
+   struct Header final{
+      uint64_t magic;
+      uint32_t record_size;
+      uint32_t capacity;
+      uint32_t writer; // process id
+      std::atomic<uint32_t> latest; // the slot to read, NONE before the first publish
+      alignas(ALIGNMENT) Slot slots[SLOTS];
+   };
+   static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+      "atomics in shared memory must not hide a lock in one process");
+
+   constexpr size_t round_up(size_t bytes) noexcept{
+      return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+   }
+   constexpr size_t slot_bytes(size_t record_size, size_t capacity) noexcept{
+      return round_up(record_size * capacity);
+   }
+   constexpr size_t total_bytes(size_t record_size, size_t capacity) noexcept{
+      return round_up(sizeof(Header)) + SLOTS * slot_bytes(record_size, capacity);
+   }
+}
+
+template<class T>
+class SharedFramesWriter final{
+   static_assert(std::is_trivially_copyable_v<T>, "shared frames are read by another process as raw bytes");
+   SharedMemory memory;
+   shared_frames_detail::Header* header;
+   size_t capacity;
+
+   SharedFramesWriter(SharedMemory memory_, size_t capacity_) noexcept
+      : memory(std::move(memory_)), header(static_cast<shared_frames_detail::Header*>(memory.data())), capacity(capacity_){}
+
+   // 'name' exists, but whoever wrote it is gone: it crashed, or it's from a build with another layout.
+   static bool abandoned(const std::string& name){
+      using namespace shared_frames_detail;
+      const auto existing = SharedMemory::open(name);
+      if(!existing){
+         return false;
+      }
+      if(existing->size() < sizeof(Header)){
+         return true;
+      }
+      const auto* header = static_cast<const Header*>(existing->data());
+      return header->magic != MAGIC || !process_alive(header->writer);
+   }
+
+   std::byte* records(size_t slot) const noexcept{
+      using namespace shared_frames_detail;
+      return static_cast<std::byte*>(memory.data()) + round_up(sizeof(Header)) + slot * slot_bytes(sizeof(T), capacity);
+   }
+
+public:
+   // 'capacity' is the most records a frame can hold. Nothing if another live process is writing 'name'.
+   static std::optional<SharedFramesWriter> create(const std::string& name, size_t capacity){
+      using namespace shared_frames_detail;
+      const size_t bytes = total_bytes(sizeof(T), capacity);
+      auto memory = SharedMemory::create(name, bytes);
+      if(!memory && abandoned(name) && SharedMemory::remove(name)){
+         memory = SharedMemory::create(name, bytes);
+      }
+      if(!memory){
+         return std::nullopt;
+      }
+      // the mapping comes zero filled: every sequence is 0 (not being written)
+      auto* header = new(memory->data()) Header{};
+      header->record_size = static_cast<uint32_t>(sizeof(T));
+      header->capacity = static_cast<uint32_t>(capacity);
+      header->writer = current_process_id();
+      header->latest.store(NONE, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      header->magic = MAGIC; // readers check this last, so they never see a half made header
+      return SharedFramesWriter(std::move(*memory), capacity);
+   }
+
+   // Writes 'count' records into the oldest slot and makes it the newest. 'fill' gets the slot's records as a span
+   // of 'count' and writes them in place, so the state can go straight from the simulation to shared memory.
+   void publish(uint64_t frame, size_t count, auto&& fill){
+      using namespace shared_frames_detail;
+      count = std::min(count, capacity);
+      const uint32_t latest = header->latest.load(std::memory_order_relaxed);
+      const uint32_t slot_index = (latest == NONE) ? 0 : (latest + 1) % SLOTS;
+      Slot& slot = header->slots[slot_index];
+      const uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+      slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release); // odd is visible before any record changes
+      fill(std::span<T>(reinterpret_cast<T*>(records(slot_index)), count));
+      slot.frame = frame;
+      slot.count = static_cast<uint32_t>(count);
+      slot.sequence.store(sequence + 2, std::memory_order_release);
+      header->latest.store(slot_index, std::memory_order_release);
+   }
+
+   void publish(uint64_t frame, std::span<const T> values){
+      publish(frame, values.size(), [&](std::span<T> out){
+         std::copy_n(values.begin(), out.size(), out.begin()); // not memcpy: an empty 'values' may have no data()
+      });
+   }
+};
+
+template<class T>
+class SharedFramesReader final{
+   static_assert(std::is_trivially_copyable_v<T>, "shared frames are read by another process as raw bytes");
+   SharedMemory memory;
+   const shared_frames_detail::Header* header;
+   size_t capacity;
+
+   SharedFramesReader(SharedMemory memory_, size_t capacity_) noexcept
+      : memory(std::move(memory_)), header(static_cast<const shared_frames_detail::Header*>(memory.data())), capacity(capacity_){}
+
+public:
+   // A frame read in place. Its records are valid until the writer comes around to its slot again; check
+   // still_valid() after using them to find out if that happened.
+   struct Frame final{
+      const shared_frames_detail::Slot* slot = nullptr;
+      uint64_t sequence = 0;
+      uint64_t frame = 0;
+      std::span<const T> records;
+
+      bool still_valid() const noexcept{
+         std::atomic_thread_fence(std::memory_order_acquire);
+         return slot->sequence.load(std::memory_order_relaxed) == sequence;
+      }
+   };
+
+   // Nothing if 'name' doesn't exist, or holds frames of another type.
+   static std::optional<SharedFramesReader> open(const std::string& name){
+      using namespace shared_frames_detail;
+      auto memory = SharedMemory::open(name);
+      if(!memory || memory->size() < sizeof(Header)){
+         return std::nullopt;
+      }
+      const auto* header = static_cast<const Header*>(memory->data());
+      if(header->magic != MAGIC || header->record_size != sizeof(T)){
+         return std::nullopt;
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if(memory->size() < total_bytes(sizeof(T), header->capacity)){
+         return std::nullopt;
+      }
+      const size_t capacity = header->capacity;
+      return SharedFramesReader(std::move(*memory), capacity);
+   }
+
+   // false once the writer's process is gone. It may have left its last frames behind: a crashed writer doesn't
+   // remove the name, and on POSIX a new writer replaces the name with new memory that this reader never sees.
+   bool writer_alive() const noexcept{
+      return process_alive(header->writer);
+   }
+
+   // The newest complete frame, or nothing before the first publish.
+   std::optional<Frame> latest() const noexcept{
+      using namespace shared_frames_detail;
+      for(size_t attempt = 0; attempt < SLOTS; ++attempt){
+         const uint32_t slot_index = header->latest.load(std::memory_order_acquire);
+         if(slot_index >= SLOTS){
+            return std::nullopt;
+         }
+         const Slot& slot = header->slots[slot_index];
+         const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+         if(sequence & 1){
+            continue; // the writer lapped us between the two loads
+         }
+         const auto* records = reinterpret_cast<const T*>(static_cast<const std::byte*>(memory.data())
+            + round_up(sizeof(Header)) + slot_index * slot_bytes(sizeof(T), capacity));
+         Frame frame{&slot, sequence, slot.frame, std::span<const T>(records, std::min<size_t>(slot.count, capacity))};
+         if(frame.still_valid()){
+            return frame;
+         }
+      }
+      return std::nullopt;
+   }
+};
@@ -0,0 +1,460 @@
+#pragma once
+#include "raylib.h"
+#include "raymath.h"
+#include "FlockField.hpp"
+#include "FlowField.hpp"
+#include "ObstacleIndex.hpp"
+#include "ObstacleMap.hpp"
+#include "SpatialIndex.hpp"
+#include "StaticObstacleIndex.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// The flocking simulation itself: obstacles, the boid and its steering, and the settings it reads.
+// Nothing in here knows about the window, the sliders or any globals, so it is shared by the game (main.cpp),
+// the World used by the C API (boids_capi.h), and anything else that wants a flock.
+
+constexpr int STAGE_WIDTH = 1280;
+constexpr int STAGE_HEIGHT = 720;
+constexpr Vector2 STAGE_SIZE = {static_cast<float>(STAGE_WIDTH), static_cast<float>(STAGE_HEIGHT)};
+constexpr Rectangle STAGE_RECT = {0.0f, 0.0f, STAGE_SIZE.x, STAGE_SIZE.y};
+constexpr Vector2 ZERO = {0.0f, 0.0f};
+constexpr float TO_RAD = DEG2RAD;
+constexpr float TO_DEG = RAD2DEG;
+constexpr int MAX_SLIDES = 3; // obstacle contacts resolved per boid per frame. The rest of the motion is dropped.
+constexpr int MAX_WALL_STEPS = 64; // distance field lookups per move against an ObstacleMap, see move_through_walls
+constexpr int MAX_SUBSTEPS = 8; // upper limit on integration sub-steps for a single boid in a single frame.
+
+constexpr static float to_float(int value) noexcept{
+   return static_cast<float>(value);
+}
+
+constexpr static float range01() noexcept{
+   constexpr auto RAND_MAXF = to_float(RAND_MAX);
+   return to_float(GetRandomValue(0, RAND_MAX)) / RAND_MAXF;
+}
+
+constexpr static float unit_range() noexcept{
+   return (range01() * 2.0f) - 1.0f;
+}
+
+constexpr static float random_range(float min, float max) noexcept{
+   return min + ((max - min) * range01());
+}
+
+constexpr static Vector2 random_range(const Vector2& min, const Vector2& max) noexcept{
+   return {
+      random_range(min.x, max.x),
+      random_range(min.y, max.y)
+   };
+}
+
+constexpr bool operator==(Color a, Color b) noexcept{
+   return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static Vector2 vector_from_angle(float angle, float magnitude) noexcept{
+   return {std::cos(angle) * magnitude, std::sin(angle) * magnitude};
+}
+
+// fmod rather than adding or subtracting the size once: a long step can carry a boid more than a world across.
+static Vector2 world_wrap(Vector2 pos, Vector2 world_size) noexcept{
+   const auto wrap = [](float x, float size){
+      if(x >= 0.0f && x <= size){ return x; }
+      x = std::fmod(x, size);
+      return (x < 0.0f) ? x + size : x;
+   };
+   return {wrap(pos.x, world_size.x), wrap(pos.y, world_size.y)};
+}
+// removes the part of 'v' that points into a surface with the given 'normal'.
+constexpr static Vector2 slide(Vector2 v, Vector2 normal) noexcept{
+   const float into = v.x * normal.x + v.y * normal.y;
+   if(into >= 0.0f){ return v; }
+   return {v.x - normal.x * into, v.y - normal.y * into};
+}
+
+// 'direction' is a unit vector.
+static void draw_boid(Vector2 position, Vector2 direction, float size, Color color) noexcept{
+   const Vector2 side = {-direction.y, direction.x};
+   const Vector2 tip = position + (direction * size * 1.4f);
+   const Vector2 left = position - (direction * size) + (side * size);
+   const Vector2 right = position - (direction * size) - (side * size);
+   DrawTriangle(tip, right, left, color);
+}
+
+struct Obstacle final{
+   Vector2 position = random_range({50.0f, 50.0f}, STAGE_SIZE);
+   float radius = random_range(15.0f, 50.0f);
+   Color color = BLUE;
+
+   void render() const noexcept{
+      DrawCircleV(position, radius, color);
+   }
+};
+
+// A hand made level, selected with --static-level on the command line. It is known when the game is compiled,
+// so its obstacle index is built by the compiler and embedded as read-only data.
+constexpr std::array STATIC_LEVEL = {
+   Obstacle{{240.0f, 180.0f}, 45.0f, BLUE},
+   Obstacle{{640.0f, 140.0f}, 30.0f, BLUE},
+   Obstacle{{1040.0f, 200.0f}, 50.0f, BLUE},
+   Obstacle{{420.0f, 400.0f}, 25.0f, BLUE},
+   Obstacle{{860.0f, 420.0f}, 40.0f, BLUE},
+   Obstacle{{200.0f, 560.0f}, 35.0f, BLUE},
+   Obstacle{{640.0f, 600.0f}, 50.0f, BLUE},
+   Obstacle{{1100.0f, 580.0f}, 20.0f, BLUE}
+};
+constexpr StaticObstacleIndex<Obstacle, STATIC_LEVEL.size(), 16, 9> STATIC_LEVEL_INDEX(STAGE_RECT, STATIC_LEVEL);
+using StaticLevelIndex = std::remove_const_t<decltype(STATIC_LEVEL_INDEX)>;
+
+enum class Integrator : uint8_t{
+   ExplicitEuler,     // position moves with the old velocity. Cheapest, and gains energy with stiff forces.
+   SemiImplicitEuler, // position moves with the new velocity. Same cost, and far more stable.
+   Verlet             // velocity Verlet. Evaluates the steering twice per step, second order accurate.
+};
+
+constexpr std::string_view to_string(Integrator integrator) noexcept{
+   switch(integrator){
+   case Integrator::ExplicitEuler: return "explicit Euler";
+   case Integrator::SemiImplicitEuler: return "semi-implicit Euler";
+   case Integrator::Verlet: return "Verlet";
+   }
+   return "unknown";
+}
+
+// The tunable parameters of the simulation. Plain values, so a copy is a consistent snapshot (see Snapshots).
+struct BoidSettings{
+   Color color = RED;
+   float size = 8.0f;
+   float vision_range = 100.0f;     // how far a boid sees others
+   float cohesion_weight = 2.3f;    // strength of moving toward group center
+   float alignment_weight = 1.5f;   // strength of matching speed and direction (eg: velocity) of group
+   float separation_weight = 2.0f;  // strength of keeping distance
+   float separation_range = 100.0f; // the distance at which separation kicks in. the closer they get, the stronger the force
+   float drag = 0.01f;              // simple drag applied to the velocity
+   float min_speed = 50.0f;
+   float max_speed = 150.0f;
+   float obstacle_avoidance_margin = 110.0f;
+   float obstacle_avoidance_weight = 3.5f; // strength of avoiding obstacles
+   float wander_distance = 50.0f;  // distance ahead of the boid to project the wander circle
+   float wander_radius = 25.0f;    // size of the wander circle
+   float wander_jitter = 30.0f * TO_RAD;  // how much the wander angle changes each tick, in radians
+   float wander_weight = 1.3f;     // steering force weight for wander behavior
+   float seek_weight = 1.2f;       // steering force weight for seek behavior
+   Integrator integrator = Integrator::SemiImplicitEuler;
+   float max_velocity_change = 0.25f; // fraction of max_speed a boid may change its velocity by in one step before it is sub-stepped
+
+   bool operator==(const BoidSettings&) const noexcept = default; // see Snapshots
+};
+
+// Everything a boid steers by, besides its neighbours. The fields are optional.
+struct Environment final{
+   const BoidSettings& config; // the snapshot for this step
+   std::span<const Obstacle> obstacles;
+   const ObstacleIndex<Obstacle>* obstacle_index = nullptr; // enables continuous collision against the obstacles
+   const FlockField* flock_field = nullptr; // approximate cohesion and alignment, see FlockField
+   const FlowField* flow_field = nullptr;   // route to the goals, see FlowField
+   const ObstacleMap* obstacle_map = nullptr; // walls loaded from a level image, see ObstacleMap
+   const StaticLevelIndex* static_obstacle_index = nullptr; // the compile-time index, used instead of obstacle_index
+   Vector2 world_size = STAGE_SIZE; // boids wrap around at the edges
+   int max_substeps = MAX_SUBSTEPS; // lowered by the FrameGovernor under load
+};
+
+struct Boid final{
+   Vector2 position = ZERO; // see place()
+   Vector2 velocity = ZERO;
+   std::vector<const Boid*> visible_boids; // non-owning pointers to nearby boids
+   float wander_angle = 0.0f; // Persistent wandering angle
+
+   // With more than 'max_neighbours' in range, only the nearest are kept (see FrameGovernor).
+   // Returns how many the query found before that cap, which is the work it did (see CostMap).
+   size_t update_visible_boids(const SpatialIndex<Boid> auto& quad_tree, float range, size_t max_neighbours = std::numeric_limits<size_t>::max()){
+      visible_boids.clear();
+      quad_tree.query_range(nearby(range), visible_boids);      
+      const size_t found = visible_boids.size();
+      if(found > max_neighbours){
+         const auto nearest = visible_boids.begin() + static_cast<ptrdiff_t>(max_neighbours);
+         std::nth_element(visible_boids.begin(), nearest, visible_boids.end(), [this](const Boid* a, const Boid* b){
+            return Vector2DistanceSqr(position, a->position) < Vector2DistanceSqr(position, b->position);
+         });
+         visible_boids.erase(nearest, visible_boids.end());
+      }
+      return found;
+   }
+
+   Rectangle nearby(float range) const noexcept{
+      return {position.x - range, position.y - range, range * 2, range * 2};
+   }
+
+   // Boids under strong forces are sub-stepped, so the frame can be long without the stiff interactions
+   // (separation, obstacles) overshooting. Everybody else takes the whole frame in one step.
+   // 'jitter' is uniform in [-1, 1] and turns the wander circle. The caller owns the random numbers, so a world
+   // can be reproducible and independent of the others.
+   void update(float deltaTime, const Environment& env, float jitter) noexcept{
+      const BoidSettings& config = env.config;
+      const Vector2 wander_force = wander(config, jitter); // random, so it's drawn once per frame and not once per sub-step.
+      Vector2 acceleration = steering(env) + wander_force;
+      const int steps = std::clamp(substeps_for(acceleration, deltaTime, config), 1, std::max(1, env.max_substeps));
+      const float h = deltaTime / to_float(steps);
+      for(int step = 0; step < steps; ++step){
+         if(step > 0 && config.integrator != Integrator::Verlet){ // Verlet already evaluated the new position
+            acceleration = steering(env) + wander_force;
+         }
+         switch(config.integrator){
+         case Integrator::ExplicitEuler:{
+            const Vector2 motion = velocity * h;
+            velocity = clamp_speed(velocity + acceleration * h, config);
+            move(motion, env);
+            break;
+         }
+         case Integrator::SemiImplicitEuler:
+            velocity = clamp_speed(velocity + acceleration * h, config);
+            move(velocity * h, env);
+            break;
+         case Integrator::Verlet:{
+            move(velocity * h + acceleration * (0.5f * h * h), env);
+            const Vector2 next_acceleration = steering(env) + wander_force;
+            velocity = clamp_speed(velocity + (acceleration + next_acceleration) * (0.5f * h), config);
+            acceleration = next_acceleration;
+            break;
+         }
+         }
+         position = world_wrap(position, env.world_size);
+      }
+   }
+
+   // How many steps it takes to keep each step's change in velocity below max_velocity_change.
+   static int substeps_for(Vector2 acceleration, float deltaTime, const BoidSettings& config) noexcept{
+      const float limit = config.max_velocity_change * config.max_speed;
+      const float change = Vector2Length(acceleration) * deltaTime;
+      if(limit <= 0.0f || change <= limit){ return 1; }
+      return std::min(MAX_SUBSTEPS, static_cast<int>(std::ceil(change / limit)));
+   }
+
+   static Vector2 clamp_speed(Vector2 v, const BoidSettings& config) noexcept{
+      return Vector2ClampValue(v, config.min_speed, config.max_speed);
+   }
+
+   // The sum of all steering forces, except wander. With a flock field, cohesion and alignment are read from it
+   // instead of summed over the visible boids.
+   Vector2 steering(const Environment& env) const noexcept{
+      const BoidSettings& config = env.config;
+      Vector2 acceleration = {0, 0};
+      acceleration += obstacle_avoidance(env.obstacles, config);
+      if(env.obstacle_map){
+         acceleration += wall_avoidance(*env.obstacle_map, config);
+      }
+      acceleration += separation(config);
+      if(env.flock_field){
+         const auto flock = env.flock_field->sample(position);
+         acceleration += alignment(flock, config);
+         acceleration += cohesion(flock, config);
+      } else{
+         acceleration += alignment(config);
+         acceleration += cohesion(config);
+      }
+      if(env.flow_field){
+         acceleration += follow(*env.flow_field, config);
+      }
+      acceleration += drag(config);
+      return acceleration;
+   }
+
+   // Moves by 'motion', but never through an obstacle: the path is swept against the obstacle index, and on
+   // contact the boid stops at the surface and slides along it with what's left of the motion.
+   // This is what keeps boids from tunneling through small obstacles when deltaTime is large.
+   // Walls of an ObstacleMap go first, and the obstacles are swept along whatever is left of the path.
+   void move(Vector2 motion, const Environment& env) noexcept{
+      if(env.obstacle_map){
+         const Vector2 start = position;
+         move_through_walls(motion, *env.obstacle_map, env.config.size);
+         motion = position - start;
+         position = start;
+      }
+      if(env.static_obstacle_index){
+         move_through(motion, *env.static_obstacle_index, env.config.size);
+      } else if(env.obstacle_index){
+         move_through(motion, *env.obstacle_index, env.config.size);
+      } else{
+         position += motion;
+      }
+   }
+
+   // 'Index' is ObstacleIndex or StaticObstacleIndex. Knowing the concrete type lets the compiler inline the queries.
+   template<class Index>
+   void move_through(Vector2 motion, const Index& index, float radius) noexcept{
+      static thread_local std::vector<const Obstacle*> candidates; // scratch, reused between calls
+      for(int i = 0; i < MAX_SLIDES && Vector2LengthSqr(motion) > 0.0f; ++i){
+         candidates.clear();
+         index.query_swept(position, position + motion, radius, candidates);
+         float first_contact = 1.0f;
+         const Obstacle* hit = nullptr;
+         for(auto obs : candidates){
+            if(auto t = sweep_circle(position, motion, radius, obs->position, obs->radius); t && *t < first_contact){
+               first_contact = *t;
+               hit = obs;
+            }
+         }
+         position += motion * first_contact;
+         if(!hit){ return; }
+         const Vector2 normal = Vector2Normalize(position - hit->position);
+         motion = slide(motion * (1.0f - first_contact), normal);
+         velocity = slide(velocity, normal);
+      }
+   }
+
+   // Sphere tracing through the distance field: no step is longer than the distance to the nearest wall, so not
+   // even a wall one pixel thin can be stepped over. At 'radius' from a wall the boid slides along it like it does
+   // along an obstacle. Steps away from the wall may be half a pixel regardless, so a boid already touching a wall
+   // can leave it. After MAX_WALL_STEPS the rest of the motion is dropped.
+   void move_through_walls(Vector2 motion, const ObstacleMap& map, float radius) noexcept{
+      const float min_step = map.resolution() * 0.5f;
+      const float touching = map.resolution() * 0.01f; // approaching at an angle, the steps shrink without ever arriving
+      int steps = 0;
+      for(int i = 0; i < MAX_SLIDES && Vector2LengthSqr(motion) > 0.0f; ++i){
+         float remaining = Vector2Length(motion);
+         const Vector2 direction = motion / remaining;
+         Vector2 normal = ZERO;
+         bool contact = false;
+         for(; remaining > 0.0f && steps < MAX_WALL_STEPS; ++steps){
+            const float clearance = map.distance_at(position) - radius;
+            const Vector2 away = map.away_from_walls(position);
+            const bool closing_in = Vector2DotProduct(direction, away) < 0.0f;
+            if(closing_in && clearance <= touching){
+               normal = away;
+               contact = true;
+               break;
+            }
+            const float step = std::min(remaining, closing_in ? clearance : std::max(clearance, min_step));
+            position += direction * step;
+            remaining -= step;
+         }
+         if(!contact){ return; }
+         motion = slide(direction * remaining, normal);
+         velocity = slide(velocity, normal);
+      }
+   }
+      
+   Vector2 obstacle_avoidance(std::span<const Obstacle> obstacles, const BoidSettings& config) const noexcept{
+      Vector2 steer{0, 0};
+      int count = 0;
+      for(const auto& obs : obstacles){
+         float safe_distance = obs.radius + config.obstacle_avoidance_margin;
+         float to_index = Vector2Distance(position, obs.position);
+         if(to_index < safe_distance){
+            Vector2 away = Vector2Normalize(position - obs.position);
+            // Scale the force by how deep the boid is within the safe distance.
+            steer += away * (safe_distance - to_index);
+            ++count;
+         }
+      }
+      if(count == 0){ return ZERO; }
+      return (steer / to_float(count)) * config.obstacle_avoidance_weight;
+   }
+
+   // Same margin and weight as the obstacles, but the distance and direction come from the map's distance field,
+   // so the cost doesn't depend on how many walls the level has.
+   Vector2 wall_avoidance(const ObstacleMap& map, const BoidSettings& config) const noexcept{
+      const float margin = config.obstacle_avoidance_margin;
+      const float distance = map.distance_at(position);
+      if(distance >= margin){ return ZERO; }
+      return map.away_from_walls(position) * (margin - distance) * config.obstacle_avoidance_weight;
+   }
+
+   Vector2 seek(Vector2 targetPos, const BoidSettings& config) const noexcept{
+      auto toward = Vector2Normalize(targetPos - position);
+      auto desired_velocity = toward * config.max_speed;
+      return (desired_velocity - velocity) * config.seek_weight;
+   }
+
+   // Seek one step down the flow field. The field already routes around obstacles, so this is global pathfinding.
+   Vector2 follow(const FlowField& flow, const BoidSettings& config) const noexcept{
+      const Vector2 direction = flow.sample(position);
+      if(Vector2LengthSqr(direction) == 0.0f){ return ZERO; }
+      return seek(position + direction, config);
+   }
+
+   Vector2 wander(const BoidSettings& config, float jitter) noexcept{
+      Vector2 circle_center = Vector2Normalize(velocity) * config.wander_distance;
+      wander_angle += jitter * config.wander_jitter;
+      Vector2 displacement = vector_from_angle(wander_angle, config.wander_radius);
+      Vector2 wanderTarget = position + circle_center + displacement;
+      return seek(wanderTarget, config) * config.wander_weight;
+   }
+
+   Vector2 separation(const BoidSettings& config) const noexcept{
+      Vector2 steer{0, 0};
+      int count = 0;
+      for(auto other : visible_boids){
+         Vector2 offset = position - other->position;
+         float to_index = Vector2Length(offset);
+         if(to_index < config.separation_range){
+            steer += Vector2Normalize(offset) * (config.separation_range - to_index); // normalize a vector pointing away from other, and scale it by the inverse of the distance
+            ++count;
+         }
+      }
+      if(count == 0){ return ZERO; }
+      return (steer / to_float(count)) * config.separation_weight; // average the contributions from all neighbors, and scale by separation weight
+   }
+
+   Vector2 alignment(const BoidSettings& config) const noexcept{
+      Vector2 sum{0, 0};
+      int count = 0;
+      for(auto other : visible_boids){
+         sum += other->velocity;
+         count++;
+      }
+      if(count == 0){ return ZERO; }
+      Vector2 average_velocity = sum / to_float(count);
+      Vector2 steer = average_velocity - velocity;
+      return steer * config.alignment_weight;
+   }
+
+   Vector2 cohesion(const BoidSettings& config) const noexcept{
+      Vector2 sum = {0, 0};
+      int count = 0;
+      for(auto other : visible_boids){
+         sum += other->position;
+         count++;
+      }
+      if(count == 0){ return ZERO; }
+      Vector2 average_position = sum / to_float(count);
+      Vector2 steer = average_position - position;
+      return steer * config.cohesion_weight;
+   }
+
+   Vector2 alignment(const FlockField::Sample& flock, const BoidSettings& config) const noexcept{
+      if(flock.density <= 0.0f){ return ZERO; }
+      return (flock.velocity - velocity) * config.alignment_weight;
+   }
+
+   Vector2 cohesion(const FlockField::Sample& flock, const BoidSettings& config) const noexcept{
+      if(flock.density <= 0.0f){ return ZERO; }
+      return (flock.center - position) * config.cohesion_weight;
+   }
+
+   Vector2 drag(const BoidSettings& config) const noexcept{
+      return velocity * -config.drag;
+   }
+
+   // The boids themselves are drawn from RenderPackets. This is the overlay for a single one, with its heading from velocity.
+   void debug_render(const BoidSettings& config) const noexcept{
+      const auto debug_color = Fade(config.color, 0.1f);
+      const Vector2 heading = (Vector2Length(velocity) != 0) ? Vector2Normalize(velocity) : Vector2{1, 0};
+      draw_boid(position, heading, config.size, config.color);
+      DrawCircleV(position, config.vision_range, debug_color);
+      for(auto other : visible_boids){
+         DrawLineV(position, other->position, debug_color);
+      }
+      DrawCircleV(position, 1, BLACK);
+   }
+};
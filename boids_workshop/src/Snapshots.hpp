@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <memory>
+
+// Snapshots publishes a value as a series of immutable copies, read-copy-update style.
+// The writer builds a new copy and swaps it in with one atomic store. Readers acquire the current copy and keep it
+// for as long as they need a consistent view (a whole simulation step), so they never see a half-written value,
+// and since no copy is ever written after it's published, readers on different cores never fight over its cache
+// lines. Old copies are reclaimed when the last reader lets go of them.
+// Acquire once per step and pass the value down by reference: copying the handle touches its shared reference count.
+// Every snapshot carries a version, bumped by each publish. A reader that derived state from an older value (a
+// flow field laid out for the old boid size, say) compares versions to find out it has to redo it.
+// std::atomic<std::shared_ptr> is not lock-free in libstdc++ or MSVC. Both guard it with a tiny internal lock, so
+// a reader can briefly wait on a writer that is mid-swap. With one acquire per step that's never contended.
+
+template<std::equality_comparable T>
+class Snapshots final{
+public:
+   struct Snapshot final{
+      T value;
+      uint64_t version = 0;
+   };
+   using Handle = std::shared_ptr<const Snapshot>;
+
+private:
+   std::atomic<Handle> current;
+
+public:
+   explicit Snapshots(const T& initial)
+      : current(std::make_shared<const Snapshot>(initial, 1)){}
+
+   // Writer side, one writer only. A new copy costs an allocation, so nothing is published unless 'value' differs
+   // from the current snapshot. Returns true if it did. Call it at step boundaries.
+   bool publish(const T& value){
+      const Handle latest = current.load(std::memory_order_relaxed); // only the writer stores, so this is the latest
+      if(latest->value == value){
+         return false;
+      }
+      current.store(std::make_shared<const Snapshot>(value, latest->version + 1), std::memory_order_release);
+      return true;
+   }
+
+   // Reader side. Safe from any thread, at any time.
+   Handle acquire() const noexcept{
+      return current.load(std::memory_order_acquire);
+   }
+};
@@ -0,0 +1,167 @@
+#include "Socket.hpp"
+#include <algorithm>
+// The OS headers stay in this file. <windows.h> clashes with raylib.h (Rectangle, CloseWindow, DrawText..).
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+using native_socket = SOCKET;
+using io_length = int;
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using native_socket = int;
+using io_length = size_t;
+#endif
+
+namespace{
+#if defined(_WIN32)
+   constexpr native_socket BAD_SOCKET = INVALID_SOCKET;
+   constexpr int SEND_FLAGS = 0;
+
+   bool start_sockets() noexcept{
+      static const bool started = []{
+         WSADATA data{};
+         return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+      }();
+      return started;
+   }
+
+   bool would_block() noexcept{
+      return WSAGetLastError() == WSAEWOULDBLOCK;
+   }
+
+   void close_native(native_socket s) noexcept{
+      closesocket(s);
+   }
+
+   bool set_non_blocking(native_socket s) noexcept{
+      u_long enabled = 1;
+      return ioctlsocket(s, FIONBIO, &enabled) == 0;
+   }
+#else
+   constexpr native_socket BAD_SOCKET = -1;
+   constexpr int SEND_FLAGS = MSG_NOSIGNAL; // a dead spectator should be an error code, not a SIGPIPE
+
+   bool start_sockets() noexcept{
+      return true;
+   }
+
+   bool would_block() noexcept{
+      return errno == EWOULDBLOCK || errno == EAGAIN;
+   }
+
+   void close_native(native_socket s) noexcept{
+      close(s);
+   }
+
+   bool set_non_blocking(native_socket s) noexcept{
+      const int flags = fcntl(s, F_GETFL, 0);
+      return flags != -1 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+   }
+#endif
+
+   native_socket native(uintptr_t handle) noexcept{
+      return static_cast<native_socket>(handle);
+   }
+
+   // small messages go out as soon as they're written, instead of waiting to be merged with the next one.
+   void disable_nagle(native_socket s) noexcept{
+      int enabled = 1;
+      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+   }
+}
+
+TcpSocket::~TcpSocket() noexcept{
+   if(valid()){
+      close_native(native(handle));
+   }
+}
+
+std::optional<TcpSocket> TcpSocket::listen(uint16_t port, bool any_interface){
+   if(!start_sockets()){
+      return std::nullopt;
+   }
+   const native_socket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+   if(s == BAD_SOCKET){
+      return std::nullopt;
+   }
+   TcpSocket owner(static_cast<uintptr_t>(s));
+   int reuse = 1;
+   setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+   sockaddr_in address{};
+   address.sin_family = AF_INET;
+   address.sin_port = htons(port);
+   address.sin_addr.s_addr = htonl(any_interface ? INADDR_ANY : INADDR_LOOPBACK);
+   if(bind(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+      || ::listen(s, SOMAXCONN) != 0 || !set_non_blocking(s)){
+      return std::nullopt;
+   }
+   return owner;
+}
+
+std::optional<TcpSocket> TcpSocket::connect(const std::string& address, uint16_t port){
+   if(!start_sockets()){
+      return std::nullopt;
+   }
+   sockaddr_in remote{};
+   remote.sin_family = AF_INET;
+   remote.sin_port = htons(port);
+   if(inet_pton(AF_INET, address.c_str(), &remote.sin_addr) != 1){
+      return std::nullopt;
+   }
+   const native_socket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+   if(s == BAD_SOCKET){
+      return std::nullopt;
+   }
+   TcpSocket owner(static_cast<uintptr_t>(s));
+   if(::connect(s, reinterpret_cast<const sockaddr*>(&remote), sizeof(remote)) != 0 || !set_non_blocking(s)){
+      return std::nullopt;
+   }
+   disable_nagle(s);
+   return owner;
+}
+
+std::optional<TcpSocket> TcpSocket::accept(){
+   const native_socket s = ::accept(native(handle), nullptr, nullptr);
+   if(s == BAD_SOCKET){
+      return std::nullopt;
+   }
+   TcpSocket owner(static_cast<uintptr_t>(s));
+   if(!set_non_blocking(s)){
+      return std::nullopt;
+   }
+   disable_nagle(s);
+   return owner;
+}
+
+std::optional<size_t> TcpSocket::send(std::span<const std::byte> bytes){
+   const auto length = static_cast<io_length>(std::min<size_t>(bytes.size(), 1 << 30));
+   const auto sent = ::send(native(handle), reinterpret_cast<const char*>(bytes.data()), length, SEND_FLAGS);
+   if(sent >= 0){
+      return static_cast<size_t>(sent);
+   }
+   if(would_block()){
+      return size_t{0};
+   }
+   return std::nullopt;
+}
+
+std::optional<size_t> TcpSocket::receive(std::span<std::byte> bytes){
+   const auto length = static_cast<io_length>(std::min<size_t>(bytes.size(), 1 << 30));
+   const auto received = recv(native(handle), reinterpret_cast<char*>(bytes.data()), length, 0);
+   if(received > 0){
+      return static_cast<size_t>(received);
+   }
+   if(received < 0 && would_block()){
+      return size_t{0};
+   }
+   return std::nullopt; // 0 is an orderly shutdown
+}
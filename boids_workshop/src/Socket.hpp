@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+
+// A minimal non-blocking TCP socket, just enough to stream to spectators. IPv4 only.
+// The platform code (Winsock / BSD sockets) lives in Socket.cpp, away from raylib.h.
+// send() and receive() never block: they report how many bytes they moved (0 if the OS buffer is full or empty)
+// or nothing once the connection is gone.
+
+class TcpSocket final{
+   static constexpr uintptr_t INVALID = ~uintptr_t{0};
+   uintptr_t handle = INVALID; // SOCKET on Windows, a file descriptor elsewhere
+
+   explicit TcpSocket(uintptr_t handle_) noexcept : handle(handle_){}
+
+public:
+   TcpSocket() noexcept = default;
+   TcpSocket(const TcpSocket&) = delete;
+   TcpSocket& operator=(const TcpSocket&) = delete;
+   TcpSocket(TcpSocket&& other) noexcept : handle(std::exchange(other.handle, INVALID)){}
+   TcpSocket& operator=(TcpSocket&& other) noexcept{
+      std::swap(handle, other.handle);
+      return *this;
+   }
+   ~TcpSocket() noexcept;
+
+   // Listens on 'port'. Loopback only unless 'any_interface' is set.
+   static std::optional<TcpSocket> listen(uint16_t port, bool any_interface = false);
+   // Connects to a dotted IPv4 address. Blocks until connected or refused.
+   static std::optional<TcpSocket> connect(const std::string& address, uint16_t port);
+
+   bool valid() const noexcept{
+      return handle != INVALID;
+   }
+
+   // A pending connection, or nothing if nobody is waiting.
+   std::optional<TcpSocket> accept();
+   std::optional<size_t> send(std::span<const std::byte> bytes);
+   std::optional<size_t> receive(std::span<std::byte> bytes);
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include "raylib.h"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// The interface shared by the spatial indices in this project (QuadTree, LinearQuadTree, PyramidQuadTree, KDTree...)
+// Any of them can be dropped into main() to answer "which objects are inside this rectangle?".
+// 'T' is the indexed type, it only needs a Vector2 'position' member.
+template<class Index, class T>
+concept SpatialIndex = requires(Index& index, const Index& const_index, std::span<const T> objects,
+                                const Rectangle& range, std::vector<const T*>& found){
+   index.rebuild(objects);
+   const_index.query_range(range, found);
+   const_index.render();
+};
+
+// The smallest rectangle around every object's position, padded so nothing lies exactly on its edge.
+template<class T>
+Rectangle compute_bounds_of(std::span<const T> objects) noexcept{
+   if(objects.empty()){ return {0, 0, 0, 0}; }
+   auto [min_x, min_y] = objects[0].position;
+   auto [max_x, max_y] = objects[0].position;
+   for(size_t i = 1; i < objects.size(); ++i){
+      const auto& pos = objects[i].position;
+      if(pos.x < min_x) min_x = pos.x;
+      if(pos.x > max_x) max_x = pos.x;
+      if(pos.y < min_y) min_y = pos.y;
+      if(pos.y > max_y) max_y = pos.y;
+   }
+   const float padding = 1.0f; // Add padding to avoid objects exactly at the boundary
+   return {
+       min_x - padding,
+       min_y - padding,
+       (max_x - min_x) + 2 * padding,
+       (max_y - min_y) + 2 * padding
+   };
+}
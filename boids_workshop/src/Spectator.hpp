@@ -0,0 +1,417 @@
+#pragma once
+#include "raylib.h"
+#include "Socket.hpp"
+#include "SpatialIndex.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Streams a running simulation to remote spectators over TCP.
+// Every spectator subscribes with a viewport and a frame rate, and only the boids inside its viewport are sent
+// (found with the spatial index), so the bandwidth follows what the spectator sees instead of the world size.
+// Positions are quantised to 1/8 world unit relative to the viewport's corner, and headings to 256 steps.
+// Each boid that was also in the previous frame sent to that spectator is sent as a one byte delta per axis.
+//
+// Every message is [u32 length][u8 type][payload], little endian. 'length' counts the type and the payload.
+//  SUBSCRIBE, client to server: f32 x, y, width, height, u16 frames per second (0 pauses the stream).
+//  FRAME, server to client:     u32 frame, f32 origin x, origin y, u32 count, then 'count' boids in ascending id order:
+//                               varint (id gap << 1 | is_delta), then i8 dx, dy or u16 x, y, then u8 heading.
+// The server only ever deltas against a frame it handed to the socket in full, and TCP delivers in order,
+// so the client always has the frame a delta refers to.
+
+constexpr uint16_t DEFAULT_SPECTATOR_PORT = 4242;
+
+struct SpectatorView final{
+   Rectangle viewport{0, 0, 0, 0};
+   uint16_t rate = 30; // frames per second
+};
+
+struct SpectatorBoid final{
+   uint32_t id = 0;       // index in the simulation, stable for as long as it runs
+   Vector2 position{0, 0};
+   float heading = 0.0f;  // radians
+};
+
+namespace spectator_detail{
+   enum Message : uint8_t{ SUBSCRIBE = 1, FRAME = 2 };
+   constexpr float QUANTUM = 0.125f;                     // world units per position step
+   constexpr float MAX_EXTENT = 65535.0f * QUANTUM;      // widest viewport a u16 can cover
+   constexpr size_t HEADER_SIZE = 5;                     // u32 length + u8 type
+   constexpr size_t MAX_MESSAGE = size_t{64} << 20;      // anything larger is a broken stream
+   constexpr float TWO_PI = 6.28318530718f;
+
+   struct Quantized final{
+      uint32_t id = 0;
+      uint16_t x = 0;
+      uint16_t y = 0;
+   };
+
+   class Writer final{
+      std::vector<std::byte>& out;
+   public:
+      explicit Writer(std::vector<std::byte>& out_) noexcept : out(out_){}
+      void u8(uint8_t v){ out.push_back(static_cast<std::byte>(v)); }
+      void u16(uint16_t v){ u8(static_cast<uint8_t>(v)); u8(static_cast<uint8_t>(v >> 8)); }
+      void u32(uint32_t v){ u16(static_cast<uint16_t>(v)); u16(static_cast<uint16_t>(v >> 16)); }
+      void f32(float v){ u32(std::bit_cast<uint32_t>(v)); }
+      void varint(uint32_t v){
+         while(v >= 0x80){
+            u8(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+         }
+         u8(static_cast<uint8_t>(v));
+      }
+      // starts a message, returns where its length goes. Call end() once the payload is written.
+      size_t begin(Message type){
+         const size_t at = out.size();
+         u32(0);
+         u8(type);
+         return at;
+      }
+      void end(size_t at) noexcept{
+         const auto length = static_cast<uint32_t>(out.size() - at - 4);
+         for(size_t i = 0; i < 4; ++i){
+            out[at + i] = static_cast<std::byte>(length >> (8 * i));
+         }
+      }
+   };
+
+   class Reader final{
+      std::span<const std::byte> in;
+      size_t at = 0;
+      bool failed = false;
+   public:
+      explicit Reader(std::span<const std::byte> in_) noexcept : in(in_){}
+      bool ok() const noexcept{ return !failed; }
+      uint8_t u8() noexcept{
+         if(at >= in.size()){
+            failed = true;
+            return 0;
+         }
+         return static_cast<uint8_t>(in[at++]);
+      }
+      uint16_t u16() noexcept{ const uint16_t lo = u8(); return static_cast<uint16_t>(lo | (u8() << 8)); }
+      uint32_t u32() noexcept{ const uint32_t lo = u16(); return lo | (uint32_t{u16()} << 16); }
+      float f32() noexcept{ return std::bit_cast<float>(u32()); }
+      uint32_t varint() noexcept{
+         uint32_t v = 0;
+         for(int shift = 0; shift < 35; shift += 7){
+            const uint8_t b = u8();
+            v |= uint32_t{b & 0x7fu} << shift;
+            if((b & 0x80) == 0){
+               return v;
+            }
+         }
+         failed = true;
+         return 0;
+      }
+   };
+
+   // Size of the first complete message in 'buffer', or 0 if it hasn't all arrived yet.
+   inline size_t complete_message(std::span<const std::byte> buffer) noexcept{
+      if(buffer.size() < HEADER_SIZE){
+         return 0;
+      }
+      Reader reader(buffer);
+      const size_t length = reader.u32();
+      return (buffer.size() >= 4 + length) ? 4 + length : 0;
+   }
+
+   inline bool message_too_large(std::span<const std::byte> buffer) noexcept{
+      return buffer.size() >= 4 && Reader(buffer).u32() > MAX_MESSAGE;
+   }
+
+   // Moves everything the socket has into 'inbox'. False once the connection is gone.
+   inline bool drain(TcpSocket& socket, std::vector<std::byte>& inbox){
+      std::byte chunk[16 * 1024];
+      while(true){
+         const auto received = socket.receive(chunk);
+         if(!received){
+            return false;
+         }
+         if(*received == 0){
+            return true;
+         }
+         inbox.insert(inbox.end(), chunk, chunk + *received);
+      }
+   }
+
+   // Sends as much of 'outbox' as the socket takes. False once the connection is gone.
+   inline bool flush(TcpSocket& socket, std::vector<std::byte>& outbox, size_t& sent){
+      while(sent < outbox.size()){
+         const auto count = socket.send(std::span{outbox}.subspan(sent));
+         if(!count){
+            return false;
+         }
+         if(*count == 0){
+            return true;
+         }
+         sent += *count;
+      }
+      outbox.clear();
+      sent = 0;
+      return true;
+   }
+
+   constexpr uint8_t quantize_heading(float radians) noexcept{
+      const float turns = radians / TWO_PI;
+      return static_cast<uint8_t>(static_cast<int>(std::floor((turns - std::floor(turns)) * 256.0f + 0.5f)) & 0xff);
+   }
+}
+
+// 'T' needs Vector2 'position' and 'velocity'. Call update() once per simulation step, after the index is rebuilt.
+template<class T>
+class SpectatorServer{
+   struct Viewer final{
+      TcpSocket socket;
+      std::vector<std::byte> inbox;
+      std::vector<std::byte> outbox;
+      size_t outbox_sent = 0;
+      std::optional<SpectatorView> view;     // nothing until the first SUBSCRIBE
+      float time_to_next_frame = 0.0f;
+      uint32_t frame = 0;
+      std::vector<spectator_detail::Quantized> baseline; // the last frame handed to the socket, ascending ids
+      bool connected = true;
+   };
+
+   std::optional<TcpSocket> listener;
+   std::vector<Viewer> viewers;
+   std::vector<const T*> found;                         // scratch for the index query
+   std::vector<uint32_t> ids;                           // scratch, the ids in the viewport
+   std::vector<spectator_detail::Quantized> current;    // scratch, the frame being encoded
+   uint64_t bytes_sent = 0;
+
+   void read_subscriptions(Viewer& viewer){
+      using namespace spectator_detail;
+      viewer.connected = drain(viewer.socket, viewer.inbox) && !message_too_large(viewer.inbox);
+      while(const size_t size = complete_message(viewer.inbox)){
+         Reader reader(std::span{viewer.inbox}.first(size));
+         reader.u32();
+         if(reader.u8() == SUBSCRIBE){
+            SpectatorView view;
+            view.viewport = {reader.f32(), reader.f32(), reader.f32(), reader.f32()};
+            view.rate = reader.u16();
+            view.viewport.width = std::clamp(view.viewport.width, 0.0f, MAX_EXTENT);
+            view.viewport.height = std::clamp(view.viewport.height, 0.0f, MAX_EXTENT);
+            if(reader.ok()){
+               viewer.view = view;
+               viewer.baseline.clear(); // new origin, so the next frame can't be a delta
+               viewer.time_to_next_frame = 0.0f;
+            }
+         }
+         viewer.inbox.erase(viewer.inbox.begin(), viewer.inbox.begin() + static_cast<ptrdiff_t>(size));
+      }
+   }
+
+   void encode_frame(Viewer& viewer, std::span<const T> objects, const SpatialIndex<T> auto& index){
+      using namespace spectator_detail;
+      const Rectangle& viewport = viewer.view->viewport;
+      found.clear();
+      index.query_range(viewport, found);
+      ids.clear();
+      for(const T* obj : found){
+         ids.push_back(static_cast<uint32_t>(obj - objects.data()));
+      }
+      std::ranges::sort(ids);
+      Writer out(viewer.outbox);
+      const size_t message = out.begin(FRAME);
+      out.u32(viewer.frame++);
+      out.f32(viewport.x);
+      out.f32(viewport.y);
+      out.u32(static_cast<uint32_t>(ids.size()));
+      current.clear();
+      auto base = viewer.baseline.begin();
+      uint32_t previous_id = 0;
+      for(const uint32_t id : ids){
+         const T& obj = objects[id];
+         const Quantized q{
+            id,
+            static_cast<uint16_t>(std::clamp(std::round((obj.position.x - viewport.x) / QUANTUM), 0.0f, 65535.0f)),
+            static_cast<uint16_t>(std::clamp(std::round((obj.position.y - viewport.y) / QUANTUM), 0.0f, 65535.0f))
+         };
+         while(base != viewer.baseline.end() && base->id < id){
+            ++base;
+         }
+         const bool known = base != viewer.baseline.end() && base->id == id;
+         const int dx = known ? q.x - base->x : 0;
+         const int dy = known ? q.y - base->y : 0;
+         const bool delta = known && std::abs(dx) <= 127 && std::abs(dy) <= 127; // wrapped boids jump too far
+         out.varint(((id - previous_id) << 1) | (delta ? 1u : 0u));
+         if(delta){
+            out.u8(static_cast<uint8_t>(static_cast<int8_t>(dx)));
+            out.u8(static_cast<uint8_t>(static_cast<int8_t>(dy)));
+         } else{
+            out.u16(q.x);
+            out.u16(q.y);
+         }
+         out.u8(quantize_heading(std::atan2(obj.velocity.y, obj.velocity.x)));
+         current.push_back(q);
+         previous_id = id;
+      }
+      out.end(message);
+      std::swap(viewer.baseline, current);
+   }
+
+public:
+   explicit SpectatorServer(uint16_t port = DEFAULT_SPECTATOR_PORT)
+      : listener(TcpSocket::listen(port)){}
+
+   bool listening() const noexcept{
+      return listener.has_value();
+   }
+
+   size_t viewer_count() const noexcept{
+      return viewers.size();
+   }
+
+   uint64_t total_bytes_sent() const noexcept{
+      return bytes_sent;
+   }
+
+   void update(std::span<const T> objects, const SpatialIndex<T> auto& index, float deltaTime){
+      if(!listener){
+         return;
+      }
+      while(auto socket = listener->accept()){
+         Viewer viewer;
+         viewer.socket = std::move(*socket);
+         viewers.push_back(std::move(viewer));
+      }
+      for(auto& viewer : viewers){
+         read_subscriptions(viewer);
+         if(!viewer.connected || !viewer.view || viewer.view->rate == 0){
+            continue;
+         }
+         viewer.time_to_next_frame -= deltaTime;
+         // a spectator that hasn't taken the last frame yet skips this one, and gets a fresher one later.
+         if(viewer.time_to_next_frame > 0.0f || !viewer.outbox.empty()){
+            continue;
+         }
+         viewer.time_to_next_frame += 1.0f / static_cast<float>(viewer.view->rate);
+         viewer.time_to_next_frame = std::max(viewer.time_to_next_frame, 0.0f); // don't burst after a stall
+         encode_frame(viewer, objects, index);
+      }
+      for(auto& viewer : viewers){
+         const size_t before = viewer.outbox.size() - viewer.outbox_sent;
+         viewer.connected = viewer.connected && spectator_detail::flush(viewer.socket, viewer.outbox, viewer.outbox_sent);
+         bytes_sent += before - (viewer.outbox.size() - viewer.outbox_sent);
+      }
+      std::erase_if(viewers, [](const Viewer& viewer){ return !viewer.connected; });
+   }
+};
+
+class SpectatorClient final{
+   TcpSocket socket;
+   std::vector<std::byte> inbox;
+   std::vector<std::byte> outbox;
+   size_t outbox_sent = 0;
+   std::vector<spectator_detail::Quantized> baseline; // the last frame received, ascending ids
+   std::vector<spectator_detail::Quantized> current;  // scratch, the frame being decoded
+   std::vector<SpectatorBoid> boids;
+   uint64_t bytes_received = 0;
+   uint32_t frames_received = 0;
+   bool connected = true;
+
+   explicit SpectatorClient(TcpSocket socket_) noexcept : socket(std::move(socket_)){}
+
+   bool decode_frame(spectator_detail::Reader& reader){
+      using namespace spectator_detail;
+      reader.u32(); // frame number
+      const Vector2 origin = {reader.f32(), reader.f32()};
+      const uint32_t count = reader.u32();
+      current.clear();
+      boids.clear();
+      auto base = baseline.begin();
+      uint32_t id = 0;
+      for(uint32_t i = 0; i < count && reader.ok(); ++i){
+         const uint32_t tag = reader.varint();
+         id += tag >> 1;
+         Quantized q{id, 0, 0};
+         if(tag & 1){
+            while(base != baseline.end() && base->id < id){
+               ++base;
+            }
+            if(base == baseline.end() || base->id != id){
+               return false; // a delta against a boid we never got: the stream is broken
+            }
+            q.x = static_cast<uint16_t>(base->x + static_cast<int8_t>(reader.u8()));
+            q.y = static_cast<uint16_t>(base->y + static_cast<int8_t>(reader.u8()));
+         } else{
+            q.x = reader.u16();
+            q.y = reader.u16();
+         }
+         const float heading = static_cast<float>(reader.u8()) * (TWO_PI / 256.0f);
+         current.push_back(q);
+         boids.push_back({id, {origin.x + q.x * QUANTUM, origin.y + q.y * QUANTUM}, heading});
+      }
+      std::swap(baseline, current);
+      return reader.ok();
+   }
+
+public:
+   static std::optional<SpectatorClient> connect(const std::string& address, uint16_t port = DEFAULT_SPECTATOR_PORT){
+      auto socket = TcpSocket::connect(address, port);
+      if(!socket){
+         return std::nullopt;
+      }
+      return SpectatorClient(std::move(*socket));
+   }
+
+   bool is_connected() const noexcept{
+      return connected;
+   }
+
+   // Asks for a new viewport or rate. Takes effect from the next frame.
+   void subscribe(const SpectatorView& view){
+      using namespace spectator_detail;
+      Writer out(outbox);
+      const size_t message = out.begin(SUBSCRIBE);
+      out.f32(view.viewport.x);
+      out.f32(view.viewport.y);
+      out.f32(view.viewport.width);
+      out.f32(view.viewport.height);
+      out.u16(view.rate);
+      out.end(message);
+   }
+
+   // Sends pending subscriptions and decodes every frame that has arrived. The boids are from the newest one.
+   void poll(){
+      using namespace spectator_detail;
+      if(!connected){
+         return;
+      }
+      const size_t before = inbox.size();
+      connected = flush(socket, outbox, outbox_sent) && drain(socket, inbox) && !message_too_large(inbox);
+      bytes_received += inbox.size() - before;
+      size_t consumed = 0;
+      while(const size_t size = complete_message(std::span{inbox}.subspan(consumed))){
+         Reader reader(std::span{inbox}.subspan(consumed, size));
+         reader.u32();
+         if(reader.u8() == FRAME){
+            connected = connected && decode_frame(reader);
+            ++frames_received;
+         }
+         consumed += size;
+      }
+      inbox.erase(inbox.begin(), inbox.begin() + static_cast<ptrdiff_t>(consumed));
+   }
+
+   std::span<const SpectatorBoid> visible() const noexcept{
+      return boids;
+   }
+
+   uint64_t total_bytes_received() const noexcept{
+      return bytes_received;
+   }
+
+   uint32_t total_frames_received() const noexcept{
+      return frames_received;
+   }
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include "raylib.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// StaticObstacleIndex is an ObstacleIndex for levels that are known when the game is compiled.
+// Everything is fixed-size and the constructor is constexpr, so a 'constexpr' instance is built by the compiler
+// and lives in the executable's read-only data: no startup cost, and the optimizer can see the whole structure.
+// It is a uniform grid where every cell holds a bitmask of the obstacles that overlap it. A query ORs the masks of
+// the cells it touches, so each obstacle is reported once without a sort or a 'seen' list.
+// 'O' needs a Vector2 'position' and a float 'radius', and a constexpr copy. At most 64 obstacles.
+
+template<class O, size_t N, size_t COLUMNS, size_t ROWS>
+class StaticObstacleIndex{
+   using mask_t = uint64_t; // bit 'i' set means obstacle 'i' overlaps the cell
+   static_assert(N <= 64, "StaticObstacleIndex: one bit per obstacle, at most 64 obstacles.");
+   static_assert(COLUMNS > 0 && ROWS > 0);
+
+   std::array<O, N> obstacles{};
+   std::array<mask_t, COLUMNS * ROWS> cells{};
+   Rectangle boundary = {0, 0, 0, 0};
+   Vector2 cell_size = {0, 0};
+
+   constexpr size_t column_of(float x) const noexcept{
+      return static_cast<size_t>(std::clamp((x - boundary.x) / cell_size.x, 0.0f, static_cast<float>(COLUMNS - 1)));
+   }
+
+   constexpr size_t row_of(float y) const noexcept{
+      return static_cast<size_t>(std::clamp((y - boundary.y) / cell_size.y, 0.0f, static_cast<float>(ROWS - 1)));
+   }
+
+   // the union of the masks of every cell overlapped by the box [min, max].
+   constexpr mask_t mask_of(Vector2 min, Vector2 max) const noexcept{
+      mask_t mask = 0;
+      const size_t last_row = row_of(max.y);
+      const size_t last_column = column_of(max.x);
+      for(size_t row = row_of(min.y); row <= last_row; ++row){
+         for(size_t column = column_of(min.x); column <= last_column; ++column){
+            mask |= cells[row * COLUMNS + column];
+         }
+      }
+      return mask;
+   }
+
+public:
+   constexpr StaticObstacleIndex(const Rectangle& boundary_, const std::array<O, N>& obstacles_) noexcept
+      : obstacles(obstacles_), boundary(boundary_){
+      cell_size = {boundary.width / static_cast<float>(COLUMNS), boundary.height / static_cast<float>(ROWS)};
+      for(size_t i = 0; i < N; ++i){
+         const O& obs = obstacles[i];
+         const size_t last_row = row_of(obs.position.y + obs.radius);
+         const size_t last_column = column_of(obs.position.x + obs.radius);
+         for(size_t row = row_of(obs.position.y - obs.radius); row <= last_row; ++row){
+            for(size_t column = column_of(obs.position.x - obs.radius); column <= last_column; ++column){
+               cells[row * COLUMNS + column] |= mask_t{1} << i;
+            }
+         }
+      }
+   }
+
+   constexpr std::span<const O> objects() const noexcept{
+      return obstacles;
+   }
+
+   // every obstacle that a circle of 'radius' could touch anywhere on its way from 'from' to 'to'.
+   constexpr void query_swept(Vector2 from, Vector2 to, float radius, std::vector<const O*>& found) const{
+      const Vector2 min = {std::min(from.x, to.x) - radius, std::min(from.y, to.y) - radius};
+      const Vector2 max = {std::max(from.x, to.x) + radius, std::max(from.y, to.y) + radius};
+      for(mask_t mask = mask_of(min, max); mask != 0; mask &= mask - 1){
+         found.push_back(&obstacles[static_cast<size_t>(std::countr_zero(mask))]);
+      }
+   }
+
+   // every obstacle that a circle of 'radius' at 'center' could touch.
+   constexpr void query_circle(Vector2 center, float radius, std::vector<const O*>& found) const{
+      query_swept(center, center, radius, found);
+   }
+
+   void render() const noexcept{
+      for(size_t row = 0; row < ROWS; ++row){
+         for(size_t column = 0; column < COLUMNS; ++column){
+            if(cells[row * COLUMNS + column] == 0){
+               continue;
+            }
+            DrawRectangleLinesEx({boundary.x + static_cast<float>(column) * cell_size.x, boundary.y + static_cast<float>(row) * cell_size.y, cell_size.x, cell_size.y}, 1, SKYBLUE);
+         }
+      }
+   }
+};
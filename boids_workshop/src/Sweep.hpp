@@ -0,0 +1,258 @@
+#pragma once
+#include "raylib.h"
+#include "LinearQuadTree.hpp"
+#include "Parallel.hpp"
+#include "Placement.hpp"
+#include "Simulation.hpp"
+#include "World.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Runs many independent worlds at once, to tune BoidSettings offline instead of one window per variant.
+// Each variant is a World with its own settings and seed. They all share one read-only Level, so the obstacle index
+// and the distance field of a level image are built once. Worlds are handed to the workers one at a time from a
+// shared counter, so a slow variant doesn't hold up a whole chunk of fast ones. A world's own parallel loops run
+// serially inside a worker (see WorkerPool), which is what we want: one world per core, no contention.
+// Metrics per variant:
+//  polarisation:    length of the mean heading, 1 when every boid flies the same way. Averaged after the warmup.
+//  clusters:        groups of boids linked by 'cluster_distance', at the last frame.
+//  mean_neighbours: visible boids per boid, averaged after the warmup. The main cost of a step.
+//  ms_per_step:     wall time of a step on one core.
+
+// The columns a variants file may set, by name. Any setting not given keeps its default.
+constexpr std::array<std::pair<std::string_view, float BoidSettings::*>, 14> SWEEP_PARAMETERS{{
+   {"vision_range", &BoidSettings::vision_range},
+   {"cohesion_weight", &BoidSettings::cohesion_weight},
+   {"alignment_weight", &BoidSettings::alignment_weight},
+   {"separation_weight", &BoidSettings::separation_weight},
+   {"separation_range", &BoidSettings::separation_range},
+   {"drag", &BoidSettings::drag},
+   {"min_speed", &BoidSettings::min_speed},
+   {"max_speed", &BoidSettings::max_speed},
+   {"obstacle_avoidance_margin", &BoidSettings::obstacle_avoidance_margin},
+   {"obstacle_avoidance_weight", &BoidSettings::obstacle_avoidance_weight},
+   {"wander_jitter", &BoidSettings::wander_jitter},
+   {"wander_weight", &BoidSettings::wander_weight},
+   {"seek_weight", &BoidSettings::seek_weight},
+   {"size", &BoidSettings::size}
+}};
+
+struct SweepVariant final{
+   BoidSettings settings;
+   uint32_t seed = 0;
+};
+
+struct SweepOptions final{
+   Vector2 world_size = STAGE_SIZE;
+   size_t boid_count = 1000;
+   uint32_t frames = 900;
+   uint32_t warmup = 300;           // frames before the metrics start
+   float deltaTime = 1.0f / 60.0f;
+   float cluster_distance = 40.0f;  // boids closer than this are in the same cluster
+};
+
+struct SweepResult final{
+   float polarisation = 0.0f;
+   uint32_t clusters = 0;
+   float mean_neighbours = 0.0f;
+   double ms_per_step = 0.0;
+};
+
+namespace sweep_detail{
+   inline float polarisation(std::span<const Boid> boids) noexcept{
+      Vector2 sum = ZERO;
+      for(const auto& boid : boids){
+         const float speed = Vector2Length(boid.velocity);
+         if(speed > 0.0f){
+            sum += boid.velocity / speed;
+         }
+      }
+      return boids.empty() ? 0.0f : Vector2Length(sum) / to_float(static_cast<int>(boids.size()));
+   }
+
+   inline float mean_neighbours(std::span<const Boid> boids) noexcept{
+      size_t sum = 0;
+      for(const auto& boid : boids){
+         sum += boid.visible_boids.size();
+      }
+      return boids.empty() ? 0.0f : static_cast<float>(sum) / static_cast<float>(boids.size());
+   }
+
+   // Connected components of "closer than 'distance'", by union-find over the neighbours from a fresh index.
+   inline uint32_t clusters(std::span<const Boid> boids, Vector2 world_size, float distance){
+      if(boids.empty()){
+         return 0;
+      }
+      std::vector<uint32_t> parent(boids.size());
+      std::iota(parent.begin(), parent.end(), 0u);
+      const auto root = [&](uint32_t i){
+         while(parent[i] != i){
+            parent[i] = parent[parent[i]]; // path halving
+            i = parent[i];
+         }
+         return i;
+      };
+      const auto capacity = static_cast<uint32_t>(std::max(1.0, std::sqrt(static_cast<double>(boids.size()))));
+      const LinearQuadTree<Boid> index({0.0f, 0.0f, world_size.x, world_size.y}, boids, capacity, 5);
+      std::vector<const Boid*> found;
+      for(size_t i = 0; i < boids.size(); ++i){
+         found.clear();
+         index.query_range(boids[i].nearby(distance), found);
+         for(const Boid* other : found){
+            if(Vector2DistanceSqr(boids[i].position, other->position) < distance * distance){
+               parent[root(static_cast<uint32_t>(i))] = root(static_cast<uint32_t>(other - boids.data()));
+            }
+         }
+      }
+      uint32_t count = 0;
+      for(uint32_t i = 0; i < parent.size(); ++i){
+         count += (root(i) == i) ? 1u : 0u;
+      }
+      return count;
+   }
+
+   inline SweepResult run(const SweepVariant& variant, const SweepOptions& options, const std::shared_ptr<const Level>& level){
+      using Clock = std::chrono::steady_clock;
+      Placement placement;
+      placement.seed = variant.seed;
+      World world(options.world_size, options.boid_count, placement, variant.settings, level);
+      SweepResult result;
+      uint32_t measured = 0;
+      const auto start = Clock::now();
+      for(uint32_t frame = 0; frame < options.frames; ++frame){
+         world.step(options.deltaTime);
+         if(frame >= options.warmup){
+            result.polarisation += polarisation(world.state());
+            result.mean_neighbours += mean_neighbours(world.state());
+            ++measured;
+         }
+      }
+      const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+      result.ms_per_step = options.frames ? elapsed.count() / options.frames : 0.0;
+      if(measured > 0){
+         result.polarisation /= static_cast<float>(measured);
+         result.mean_neighbours /= static_cast<float>(measured);
+      }
+      result.clusters = clusters(world.state(), options.world_size, options.cluster_distance);
+      return result;
+   }
+
+   inline std::vector<std::string_view> split(std::string_view line, char separator){
+      std::vector<std::string_view> fields;
+      while(true){
+         const size_t end = line.find(separator);
+         std::string_view field = line.substr(0, end);
+         while(!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+         while(!field.empty() && (field.back() == ' ' || field.back() == '\t' || field.back() == '\r')) field.remove_suffix(1);
+         fields.push_back(field);
+         if(end == std::string_view::npos){
+            return fields;
+         }
+         line.remove_prefix(end + 1);
+      }
+   }
+
+   template<class V>
+   bool parse(std::string_view text, V& value) noexcept{
+      const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+      return error == std::errc{} && end == text.data() + text.size();
+   }
+}
+
+// Runs every variant, in parallel across the cores. result[i] belongs to variants[i].
+inline std::vector<SweepResult> run_sweep(std::span<const SweepVariant> variants, const SweepOptions& options, std::shared_ptr<const Level> level){
+   std::vector<SweepResult> results(variants.size());
+   if(variants.empty()){
+      return results;
+   }
+   std::atomic<size_t> next{0};
+   const size_t workers = std::min(variants.size(), hardware_workers());
+   parallel_for(workers, workers, [&](size_t, size_t, size_t){
+      for(size_t i = next.fetch_add(1, std::memory_order_relaxed); i < variants.size(); i = next.fetch_add(1, std::memory_order_relaxed)){
+         results[i] = sweep_detail::run(variants[i], options, level);
+      }
+   });
+   return results;
+}
+
+// A CSV file with a header row. 'seed' and the names in SWEEP_PARAMETERS are the columns, in any order and subset.
+// Lines starting with # are comments. Every setting not in the file keeps its value from 'defaults'.
+inline std::optional<std::vector<SweepVariant>> load_sweep_variants(const std::string& path, const BoidSettings& defaults){
+   using namespace sweep_detail;
+   std::ifstream file(path);
+   if(!file){
+      TraceLog(LOG_WARNING, "SWEEP: Failed to open variants '%s'", path.c_str());
+      return std::nullopt;
+   }
+   std::vector<float BoidSettings::*> columns; // nullptr is the seed
+   std::vector<SweepVariant> variants;
+   std::string line;
+   for(size_t line_number = 1; std::getline(file, line); ++line_number){
+      if(line.empty() || line[0] == '#' || line == "\r"){
+         continue;
+      }
+      const auto fields = split(line, ',');
+      if(columns.empty()){
+         for(const auto name : fields){
+            const auto known = std::ranges::find(SWEEP_PARAMETERS, name, &std::pair<std::string_view, float BoidSettings::*>::first);
+            if(name != "seed" && known == SWEEP_PARAMETERS.end()){
+               TraceLog(LOG_WARNING, "SWEEP: Unknown column '%.*s' in '%s'", static_cast<int>(name.size()), name.data(), path.c_str());
+               return std::nullopt;
+            }
+            columns.push_back(name == "seed" ? nullptr : known->second);
+         }
+         continue;
+      }
+      if(fields.size() != columns.size()){
+         TraceLog(LOG_WARNING, "SWEEP: Line %zu of '%s' has %zu fields, expected %zu", line_number, path.c_str(), fields.size(), columns.size());
+         return std::nullopt;
+      }
+      SweepVariant variant{defaults, static_cast<uint32_t>(variants.size())};
+      for(size_t i = 0; i < fields.size(); ++i){
+         const bool ok = columns[i] ? parse(fields[i], variant.settings.*columns[i]) : parse(fields[i], variant.seed);
+         if(!ok){
+            TraceLog(LOG_WARNING, "SWEEP: Bad value '%.*s' on line %zu of '%s'", static_cast<int>(fields[i].size()), fields[i].data(), line_number, path.c_str());
+            return std::nullopt;
+         }
+      }
+      variants.push_back(variant);
+   }
+   return variants;
+}
+
+// One row per variant: its seed and every parameter, then the metrics. CSV, so it loads straight into a spreadsheet.
+inline bool write_sweep_results(const std::string& path, std::span<const SweepVariant> variants, std::span<const SweepResult> results){
+   std::ofstream file(path);
+   if(!file){
+      TraceLog(LOG_WARNING, "SWEEP: Failed to write results '%s'", path.c_str());
+      return false;
+   }
+   file << "variant,seed";
+   for(const auto& [name, member] : SWEEP_PARAMETERS){
+      file << ',' << name;
+   }
+   file << ",polarisation,clusters,mean_neighbours,ms_per_step\n";
+   for(size_t i = 0; i < variants.size() && i < results.size(); ++i){
+      file << i << ',' << variants[i].seed;
+      for(const auto& [name, member] : SWEEP_PARAMETERS){
+         file << ',' << variants[i].settings.*member;
+      }
+      const auto& r = results[i];
+      file << ',' << r.polarisation << ',' << r.clusters << ',' << r.mean_neighbours << ',' << r.ms_per_step << '\n';
+   }
+   return static_cast<bool>(file);
+}
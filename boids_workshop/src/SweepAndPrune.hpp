@@ -0,0 +1,122 @@
+#pragma once
+#include "raylib.h"
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// SweepAndPrune keeps all objects in one list sorted along the dominant axis of the flock.
+// A range query is a binary search to the start of the range followed by a linear scan to its end,
+// and only the other axis needs testing along the way.
+// Objects move very little between frames, so last frame's order is nearly sorted already.
+// Insertion sort exploits that: maintenance is O(n + swaps) instead of the O(n log n) of a rebuild.
+// Works best for elongated flocks, where the dominant axis spreads the objects out the most.
+
+template<class T>
+class SweepAndPrune{
+   static constexpr float SWITCH_RATIO = 1.5f;  // hysteresis: the other axis must be this much more spread out before we switch.
+   static constexpr size_t RENDER_STRIDE = 16;  // draw a divider for every n:th entry
+
+   enum class Axis : uint8_t{ X, Y };
+
+   struct Entry final{
+      float key = 0.0f; // position along the sort axis, cached so the sort and the search stay in this vector.
+      const T* object = nullptr;
+   };
+
+   std::vector<Entry> entries;   // sorted by 'key'
+   const T* tracked = nullptr;   // the collection we were built from, anything else forces a full sort.
+   size_t tracked_count = 0;
+   Axis axis = Axis::X;
+
+   static constexpr float along(Axis a, Vector2 pos) noexcept{
+      return (a == Axis::X) ? pos.x : pos.y;
+   }
+
+   // Variance along each axis picks the dominant one. Sticky, so a round flock doesn't flip-flop every frame.
+   static Axis dominant_axis(std::span<const T> objects, Axis current) noexcept{
+      double sum_x = 0, sum_y = 0, sum_xx = 0, sum_yy = 0;
+      for(const auto& obj : objects){
+         sum_x += obj.position.x;
+         sum_y += obj.position.y;
+         sum_xx += static_cast<double>(obj.position.x) * obj.position.x;
+         sum_yy += static_cast<double>(obj.position.y) * obj.position.y;
+      }
+      const auto n = static_cast<double>(objects.size());
+      const double var_x = sum_xx / n - (sum_x / n) * (sum_x / n);
+      const double var_y = sum_yy / n - (sum_y / n) * (sum_y / n);
+      const double current_var = (current == Axis::X) ? var_x : var_y;
+      const double other_var = (current == Axis::X) ? var_y : var_x;
+      if(other_var > current_var * SWITCH_RATIO){
+         return (current == Axis::X) ? Axis::Y : Axis::X;
+      }
+      return current;
+   }
+
+   static void insertion_sort(std::vector<Entry>& list) noexcept{
+      for(size_t i = 1; i < list.size(); ++i){
+         const Entry entry = list[i];
+         size_t j = i;
+         for(; j > 0 && list[j - 1].key > entry.key; --j){
+            list[j] = list[j - 1];
+         }
+         list[j] = entry;
+      }
+   }
+
+   void build(std::span<const T> objects){
+      tracked = objects.data();
+      tracked_count = objects.size();
+      entries.clear();
+      entries.reserve(objects.size());
+      if(objects.empty()){ return; }
+      axis = dominant_axis(objects, axis);
+      for(const auto& obj : objects){
+         entries.push_back({along(axis, obj.position), std::addressof(obj)});
+      }
+      std::ranges::sort(entries, {}, &Entry::key);
+   }
+
+public:
+   SweepAndPrune() = default;
+   explicit SweepAndPrune(std::span<const T> objects){
+      build(objects);
+   }
+
+   // As long as we're handed the same collection, the keys are refreshed and last frame's order is
+   // repaired with an insertion sort. A new collection, or a change of dominant axis, sorts from scratch.
+   void rebuild(std::span<const T> objects){
+      if(objects.data() != tracked || objects.size() != tracked_count || objects.empty()){
+         build(objects);
+         return;
+      }
+      if(dominant_axis(objects, axis) != axis){
+         build(objects);
+         return;
+      }
+      for(auto& entry : entries){
+         entry.key = along(axis, entry.object->position);
+      }
+      insertion_sort(entries);
+   }
+
+   void render() const noexcept{
+      for(size_t i = 0; i < entries.size(); i += RENDER_STRIDE){
+         const float key = entries[i].key;
+         const Vector2 start = (axis == Axis::X) ? Vector2{key, 0} : Vector2{0, key};
+         const Vector2 end = (axis == Axis::X) ? Vector2{key, static_cast<float>(GetScreenHeight())} : Vector2{static_cast<float>(GetScreenWidth()), key};
+         DrawLineV(start, end, GREEN);
+      }
+   }
+
+   void query_range(const Rectangle& range, std::vector<const T*>& found) const{
+      const float min = (axis == Axis::X) ? range.x : range.y;
+      const float max = min + ((axis == Axis::X) ? range.width : range.height);
+      auto it = std::ranges::lower_bound(entries, min, {}, &Entry::key);
+      for(; it != entries.end() && it->key < max; ++it){
+         if(CheckCollisionPointRec(it->object->position, range)){
+            found.push_back(it->object);
+         }
+      }
+   }
+};
@@ -0,0 +1,177 @@
+#pragma once
+#include "raylib.h"
+#include "HugePages.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// UniformGrid buckets objects into square cells and stores them sorted by cell, so every cell is a contiguous
+// range of the 'data' vector. The build is a parallel counting sort:
+//  1. every worker computes the cell of each object in its chunk, and histograms them into its own counters.
+//  2. a parallel prefix sum over (cell, worker) turns the counters into write offsets.
+//  3. every worker scatters its chunk into 'data' through its own offsets.
+// Per-worker counters instead of shared atomics means no contention and a deterministic, stable order.
+// Pick a cell size close to the query size; a query then touches about 3x3 cells.
+
+template<class T>
+class UniformGrid{
+   using index_t = uint32_t; // index to an object in the original collection or data vector
+   using cell_t = uint32_t;  // index to a cell, row-major
+
+   std::vector<const T*, HugePageAllocator<const T*>> data; // object pointers, sorted by cell. See HugePages.hpp
+   std::vector<index_t> cell_start;  // first index into 'data' for every cell, plus one past the end.
+   std::vector<cell_t> cell_of;      // cell of every object in the collection, or 'outside' if not in the grid.
+   std::vector<index_t> counters;    // 'workers' x 'cell_count' histograms, turned into write offsets in place.
+   std::vector<index_t> partials;    // per-worker sums for the prefix sum
+   Rectangle boundary = {0, 0, 0, 0};
+   float cell_size = 100.0f;
+   cell_t columns = 0;
+   cell_t rows = 0;
+
+   constexpr cell_t cell_count() const noexcept{
+      return columns * rows;
+   }
+
+   constexpr cell_t outside() const noexcept{
+      return cell_count();
+   }
+
+   constexpr cell_t column_of(float x) const noexcept{
+      return static_cast<cell_t>(std::clamp((x - boundary.x) / cell_size, 0.0f, static_cast<float>(columns - 1)));
+   }
+
+   constexpr cell_t row_of(float y) const noexcept{
+      return static_cast<cell_t>(std::clamp((y - boundary.y) / cell_size, 0.0f, static_cast<float>(rows - 1)));
+   }
+
+   constexpr cell_t cell_at(Vector2 pos) const noexcept{
+      if(!CheckCollisionPointRec(pos, boundary)){
+         return outside();
+      }
+      return row_of(pos.y) * columns + column_of(pos.x);
+   }
+
+   // counters are laid out worker-major, so each worker's histogram is contiguous and never shares a cache line
+   // with another worker's (except at the seams).
+   constexpr index_t& counter(size_t worker, cell_t cell) noexcept{
+      return counters[worker * cell_count() + cell];
+   }
+
+   // Exclusive prefix sum over the histograms in (cell, worker) order: all of cell 0 from worker 0, 1, 2.. then cell 1.
+   // Afterwards counter(w, c) is where worker 'w' writes its first object of cell 'c'.
+   void prefix_sum(size_t workers){
+      const cell_t cells = cell_count();
+      const size_t scan_workers = std::min<size_t>(workers, cells);
+      partials.assign(scan_workers + 1, 0);
+      // a. every worker sums the objects in its chunk of cells.
+      parallel_for(cells, scan_workers, [&](size_t w, size_t begin, size_t end){
+         index_t sum = 0;
+         for(size_t c = begin; c < end; ++c){
+            for(size_t source = 0; source < workers; ++source){
+               sum += counter(source, static_cast<cell_t>(c));
+            }
+         }
+         partials[w + 1] = sum;
+      });
+      // b. scan the handful of partial sums serially.
+      for(size_t w = 1; w < partials.size(); ++w){
+         partials[w] += partials[w - 1];
+      }
+      // c. every worker rescans its chunk, starting from the total of all chunks before it.
+      parallel_for(cells, scan_workers, [&](size_t w, size_t begin, size_t end){
+         index_t running = partials[w];
+         for(size_t c = begin; c < end; ++c){
+            const auto cell = static_cast<cell_t>(c);
+            cell_start[cell] = running;
+            for(size_t source = 0; source < workers; ++source){
+               const index_t count = counter(source, cell);
+               counter(source, cell) = running;
+               running += count;
+            }
+         }
+      });
+      cell_start[cells] = partials.back();
+   }
+
+public:
+   UniformGrid() = default;
+   UniformGrid(const Rectangle& boundary_, std::span<const T> objects, float cell_size_)
+      : boundary(boundary_), cell_size(cell_size_){
+      assert(cell_size > 0.0f);
+      columns = std::max(cell_t{1}, static_cast<cell_t>(std::ceil(boundary.width / cell_size)));
+      rows = std::max(cell_t{1}, static_cast<cell_t>(std::ceil(boundary.height / cell_size)));
+      cell_start.resize(cell_count() + 1);
+      rebuild(objects);
+   }
+
+   void rebuild(std::span<const T> objects){
+      const size_t count = objects.size();
+      const size_t workers = workers_for(count);
+      const cell_t cells = cell_count();
+      if(cells == 0){ // default constructed: no grid, so nothing can be in it
+         data.clear();
+         return;
+      }
+      cell_of.resize(count);
+      counters.assign(workers * cells, 0);
+      // 1. compute cell ids and per-worker histograms.
+      parallel_for(count, workers, [&](size_t w, size_t begin, size_t end){
+         for(size_t i = begin; i < end; ++i){
+            const cell_t cell = cell_at(objects[i].position);
+            cell_of[i] = cell;
+            if(cell != outside()){
+               ++counter(w, cell);
+            }
+         }
+      });
+      // 2. turn the histograms into write offsets.
+      prefix_sum(workers);
+      // 3. scatter. Every worker owns its offsets, so no two threads ever write the same slot.
+      data.resize(cell_start[cells]);
+      parallel_for(count, workers, [&](size_t w, size_t begin, size_t end){
+         for(size_t i = begin; i < end; ++i){
+            const cell_t cell = cell_of[i];
+            if(cell != outside()){
+               data[counter(w, cell)++] = std::addressof(objects[i]);
+            }
+         }
+      });
+   }
+
+   void render() const noexcept{
+      for(cell_t row = 0; row < rows; ++row){
+         for(cell_t column = 0; column < columns; ++column){
+            const cell_t cell = row * columns + column;
+            if(cell_start[cell] == cell_start[cell + 1]){
+               continue;
+            }
+            DrawRectangleLinesEx({boundary.x + static_cast<float>(column) * cell_size, boundary.y + static_cast<float>(row) * cell_size, cell_size, cell_size}, 1, GREEN);
+         }
+      }
+   }
+
+   void query_range(const Rectangle& range, std::vector<const T*>& found) const{
+      if(data.empty() || !CheckCollisionRecs(boundary, range)){
+         return;
+      }
+      const cell_t first_column = column_of(range.x);
+      const cell_t last_column = column_of(range.x + range.width);
+      const cell_t first_row = row_of(range.y);
+      const cell_t last_row = row_of(range.y + range.height);
+      for(cell_t row = first_row; row <= last_row; ++row){
+         // cells in a row are adjacent in 'data', so each row is one contiguous run.
+         const index_t begin = cell_start[row * columns + first_column];
+         const index_t end = cell_start[row * columns + last_column + 1];
+         for(index_t i = begin; i < end; ++i){
+            if(CheckCollisionPointRec(data[i]->position, range)){
+               found.push_back(data[i]);
+            }
+         }
+      }
+   }
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include "raylib.h"
+#include "HugePages.hpp"
+#include "LinearQuadTree.hpp"
+#include "ObstacleIndex.hpp"
+#include "Parallel.hpp"
+#include "Placement.hpp"
+#include "Simulation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// A self-contained flock: the boids, the obstacles, and the indices over them, stepped with its own settings.
+// No window, no sliders, no globals, so any number of worlds can exist side by side. This is what the C API
+// (boids_capi.h) hands out, and the step is the same one the game runs (see main), minus the optional fields.
+// The boids are stored contiguously and never move in memory, so state() can be read in place between steps.
+// Every random number is drawn from (seed, frame, boid), so a world is reproducible and shares no state with others.
+
+// Obstacles and their index, and the walls of a level image. Immutable once built, so any number of worlds can share one.
+struct Level final{
+   std::vector<Obstacle> obstacles;
+   ObstacleIndex<Obstacle> index; // points into 'obstacles'
+   std::shared_ptr<const ObstacleMap> map; // null without a level image
+
+   Level(const Rectangle& bounds, std::vector<Obstacle> obstacles_, std::shared_ptr<const ObstacleMap> map_ = nullptr)
+      : obstacles(std::move(obstacles_)), index(bounds, obstacles), map(std::move(map_)){}
+   Level(const Level&) = delete;
+   Level& operator=(const Level&) = delete;
+};
+
+class World final{
+   using Boids = FirstTouchArray<Boid, HugePageAllocator<Boid>>;
+
+   BoidSettings config;
+   Rectangle bounds;
+   std::shared_ptr<const Level> level; // null without obstacles or walls
+   Boids boids;
+   LinearQuadTree<Boid> boid_index;
+   uint32_t seed;
+   uint64_t frame = 0;
+
+   static uint32_t capacity_for(size_t boid_count) noexcept{
+      return static_cast<uint32_t>(std::max(1.0, std::sqrt(static_cast<double>(boid_count))));
+   }
+
+public:
+   World(Vector2 size, size_t boid_count, const Placement& placement, const BoidSettings& config_ = {}, std::shared_ptr<const Level> level_ = nullptr)
+      : config(config_), bounds{0.0f, 0.0f, size.x, size.y}, level(std::move(level_)), boids(boid_count),
+      boid_index(bounds, boids, capacity_for(boid_count), 5), seed(placement.seed){
+      place<Boid>(boids, bounds, config.min_speed, placement);
+   }
+   World(const World&) = delete;
+   World& operator=(const World&) = delete;
+   World(World&&) noexcept = default;
+   World& operator=(World&&) noexcept = default;
+
+   // The level may be shared, so it is copied with the new obstacle rather than changed. Meant for setup, not per step.
+   void add_obstacle(Vector2 position, float radius){
+      std::vector<Obstacle> obstacles = level ? level->obstacles : std::vector<Obstacle>{};
+      obstacles.push_back(Obstacle{position, radius, BLUE});
+      level = std::make_shared<const Level>(bounds, std::move(obstacles), level ? level->map : nullptr);
+   }
+
+   void step(float deltaTime){
+      using namespace placement_detail;
+      boid_index.rebuild(boids);
+      const Environment env{.config = config, .obstacles = obstacle_list(),
+         .obstacle_index = level ? &level->index : nullptr, .obstacle_map = level ? level->map.get() : nullptr,
+         .world_size = {bounds.width, bounds.height}};
+      parallel_for(boids.size(), workers_for(boids.size()), [&](size_t, size_t begin, size_t end){
+         for(size_t i = begin; i < end; ++i){
+            boids[i].update_visible_boids(boid_index, config.vision_range);
+         }
+      });
+      const uint32_t frame_seed = mix(seed ^ mix(static_cast<uint32_t>(frame)));
+      for(size_t i = 0; i < boids.size(); ++i){
+         boids[i].update(deltaTime, env, random01(frame_seed, static_cast<uint32_t>(i), WANDER) * 2.0f - 1.0f);
+      }
+      ++frame;
+   }
+
+   BoidSettings& settings() noexcept{ return config; }
+   const BoidSettings& settings() const noexcept{ return config; }
+   std::span<const Boid> state() const noexcept{ return {boids.data(), boids.size()}; }
+   std::span<const Obstacle> obstacle_list() const noexcept{ return level ? std::span<const Obstacle>(level->obstacles) : std::span<const Obstacle>{}; }
+   Vector2 size() const noexcept{ return {bounds.width, bounds.height}; }
+   uint64_t frames() const noexcept{ return frame; }
+};
@@ -0,0 +1,142 @@
+#include "boids_capi.h"
+#include "World.hpp"
+#include <cmath>
+#include <cstddef>
+
+// The handle is the World itself. No exception crosses the C boundary: failures become NULL or -1.
+// Anything may throw, from out of memory to the worker pool failing to start its threads, so every call catches all.
+struct boids_world final{
+   World world;
+};
+
+namespace{
+   float* param_of(BoidSettings& config, boids_param param) noexcept{
+      switch(param){
+      case BOIDS_PARAM_VISION_RANGE: return &config.vision_range;
+      case BOIDS_PARAM_COHESION_WEIGHT: return &config.cohesion_weight;
+      case BOIDS_PARAM_ALIGNMENT_WEIGHT: return &config.alignment_weight;
+      case BOIDS_PARAM_SEPARATION_WEIGHT: return &config.separation_weight;
+      case BOIDS_PARAM_SEPARATION_RANGE: return &config.separation_range;
+      case BOIDS_PARAM_DRAG: return &config.drag;
+      case BOIDS_PARAM_MIN_SPEED: return &config.min_speed;
+      case BOIDS_PARAM_MAX_SPEED: return &config.max_speed;
+      case BOIDS_PARAM_OBSTACLE_MARGIN: return &config.obstacle_avoidance_margin;
+      case BOIDS_PARAM_OBSTACLE_WEIGHT: return &config.obstacle_avoidance_weight;
+      case BOIDS_PARAM_WANDER_WEIGHT: return &config.wander_weight;
+      case BOIDS_PARAM_WANDER_JITTER: return &config.wander_jitter;
+      case BOIDS_PARAM_SEEK_WEIGHT: return &config.seek_weight;
+      case BOIDS_PARAM_SIZE: return &config.size;
+      }
+      return nullptr;
+   }
+
+   // The settings the simulation is defined for. Checked on a copy, so a rejected value never reaches the world.
+   bool in_domain(BoidSettings& config) noexcept{
+      for(int param = BOIDS_PARAM_VISION_RANGE; param <= BOIDS_PARAM_SIZE; ++param){
+         if(!(*param_of(config, static_cast<boids_param>(param)) >= 0.0f)){
+            return false;
+         }
+      }
+      return config.size > 0.0f && config.min_speed <= config.max_speed;
+   }
+
+   const float* field_of(const boids_world* world, size_t offset, size_t* stride_bytes) noexcept{
+      if(stride_bytes){
+         *stride_bytes = sizeof(Boid);
+      }
+      if(!world || world->world.state().empty()){
+         return nullptr;
+      }
+      const auto* first = reinterpret_cast<const std::byte*>(world->world.state().data());
+      return reinterpret_cast<const float*>(first + offset);
+   }
+}
+
+int boids_api_version(void){
+   return BOIDS_API_VERSION;
+}
+
+boids_world* boids_world_create(float width, float height, uint32_t boid_count, uint32_t seed){
+   if(!(width > 0.0f) || !(height > 0.0f) || !std::isfinite(width) || !std::isfinite(height)){
+      return nullptr;
+   }
+   try{
+      Placement placement;
+      placement.seed = seed;
+      return new boids_world{World({width, height}, boid_count, placement)};
+   } catch(...){
+      return nullptr;
+   }
+}
+
+void boids_world_destroy(boids_world* world){
+   delete world;
+}
+
+int boids_world_add_obstacle(boids_world* world, float x, float y, float radius){
+   if(!world || !(radius > 0.0f) || !std::isfinite(x) || !std::isfinite(y) || !std::isfinite(radius)){
+      return -1;
+   }
+   try{
+      world->world.add_obstacle({x, y}, radius);
+      return 0;
+   } catch(...){
+      return -1;
+   }
+}
+
+int boids_world_set_param(boids_world* world, boids_param param, float value){
+   if(!world || !std::isfinite(value)){
+      return -1;
+   }
+   BoidSettings changed = world->world.settings();
+   float* target = param_of(changed, param);
+   if(!target){
+      return -1;
+   }
+   *target = value;
+   if(!in_domain(changed)){
+      return -1;
+   }
+   world->world.settings() = changed;
+   return 0;
+}
+
+float boids_world_get_param(const boids_world* world, boids_param param){
+   if(!world){
+      return NAN;
+   }
+   BoidSettings copy = world->world.settings();
+   const float* source = param_of(copy, param);
+   return source ? *source : NAN;
+}
+
+int boids_world_step(boids_world* world, uint32_t frames, float dt){
+   if(!world || !(dt >= 0.0f && dt <= BOIDS_MAX_DT)){
+      return -1;
+   }
+   try{
+      for(uint32_t i = 0; i < frames; ++i){
+         world->world.step(dt);
+      }
+      return 0;
+   } catch(...){
+      return -1;
+   }
+}
+
+uint32_t boids_world_count(const boids_world* world){
+   return world ? static_cast<uint32_t>(world->world.state().size()) : 0;
+}
+
+uint64_t boids_world_frame(const boids_world* world){
+   return world ? world->world.frames() : 0;
+}
+
+const float* boids_world_positions(const boids_world* world, size_t* stride_bytes){
+   return field_of(world, offsetof(Boid, position), stride_bytes);
+}
+
+const float* boids_world_velocities(const boids_world* world, size_t* stride_bytes){
+   return field_of(world, offsetof(Boid, velocity), stride_bytes);
+}
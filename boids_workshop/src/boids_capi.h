@@ -0,0 +1,76 @@
+#pragma once
+/*
+ * A C interface to the flocking simulation, for embedding it in another engine.
+ * Worlds are opaque handles. The boid state is read in place, without copying: the position and velocity
+ * accessors return a pointer to the first boid's x, and a stride in bytes from one boid to the next
+ * (the boids are an array of structs). Y follows x. The pointers stay valid, and the values don't change,
+ * until the next call to boids_world_step or boids_world_destroy on that world.
+ * Calls on one world must not overlap. Different worlds may be used from different threads.
+ * boids_capi.vcxproj builds this as a DLL. Define BOIDS_SHARED when including it to link against that DLL.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(BOIDS_SHARED)
+   #if defined(BOIDS_EXPORTS)
+      #define BOIDS_API __declspec(dllexport)
+   #else
+      #define BOIDS_API __declspec(dllimport)
+   #endif
+#else
+   #define BOIDS_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct boids_world boids_world;
+
+/* Bumped whenever a function or a parameter changes meaning. */
+#define BOIDS_API_VERSION 1
+
+/* The longest step boids_world_step takes, in seconds. For more, step more frames. */
+#define BOIDS_MAX_DT 1.0f
+
+typedef enum boids_param{
+   BOIDS_PARAM_VISION_RANGE = 0,
+   BOIDS_PARAM_COHESION_WEIGHT,
+   BOIDS_PARAM_ALIGNMENT_WEIGHT,
+   BOIDS_PARAM_SEPARATION_WEIGHT,
+   BOIDS_PARAM_SEPARATION_RANGE,
+   BOIDS_PARAM_DRAG,
+   BOIDS_PARAM_MIN_SPEED,
+   BOIDS_PARAM_MAX_SPEED,
+   BOIDS_PARAM_OBSTACLE_MARGIN,
+   BOIDS_PARAM_OBSTACLE_WEIGHT,
+   BOIDS_PARAM_WANDER_WEIGHT,
+   BOIDS_PARAM_WANDER_JITTER, /* radians per step */
+   BOIDS_PARAM_SEEK_WEIGHT,
+   BOIDS_PARAM_SIZE           /* the boid's radius against obstacles */
+} boids_param;
+
+BOIDS_API int boids_api_version(void);
+
+/* Boids are placed uniformly at random from 'seed'. Returns NULL if out of memory or the arguments are invalid. */
+BOIDS_API boids_world* boids_world_create(float width, float height, uint32_t boid_count, uint32_t seed);
+BOIDS_API void boids_world_destroy(boids_world* world);
+
+/* Returns 0 on success, -1 on invalid arguments or out of memory. */
+BOIDS_API int boids_world_add_obstacle(boids_world* world, float x, float y, float radius);
+/* Every parameter is zero or more, the size is more than zero, and MIN_SPEED can't exceed MAX_SPEED (to raise both,
+ * set MAX_SPEED first). Returns -1, and changes nothing, for a value outside that. */
+BOIDS_API int boids_world_set_param(boids_world* world, boids_param param, float value);
+BOIDS_API float boids_world_get_param(const boids_world* world, boids_param param);
+
+/* Advances 'frames' steps of 'dt' seconds each. Returns -1 unless 'dt' is in [0, BOIDS_MAX_DT]. */
+BOIDS_API int boids_world_step(boids_world* world, uint32_t frames, float dt);
+
+BOIDS_API uint32_t boids_world_count(const boids_world* world);
+BOIDS_API uint64_t boids_world_frame(const boids_world* world);
+BOIDS_API const float* boids_world_positions(const boids_world* world, size_t* stride_bytes);
+BOIDS_API const float* boids_world_velocities(const boids_world* world, size_t* stride_bytes);
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,92 +18,70 @@
 #include "raylib.h"
 #include "raymath.h"
 #include "Slider.h"
+#include <algorithm>
 #include <array>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <memory>
+#include <optional>
+#include <random>
 #include <span>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "QuadTree.h"
 #include "LinearQuadTree.hpp"
+#include "PyramidQuadTree.hpp"
+#include "KDTree.hpp"
+#include "AABBTree.hpp"
+#include "SweepAndPrune.hpp"
+#include "UniformGrid.hpp"
+#include "HierarchicalGrid.hpp"
+#include "HugePages.hpp"
+#include "FlockField.hpp"
+#include "CostMap.hpp"
+#include "FlowField.hpp"
+#include "Governor.hpp"
+#include "Metrics.hpp"
+#include "ObstacleIndex.hpp"
+#include "ObstacleMap.hpp"
+#include "SharedMemory.hpp"
+#include "Snapshots.hpp"
+#include "Parallel.hpp"
+#include "Placement.hpp"
+#include "RenderPackets.hpp"
+#include "Simulation.hpp"
+#include "StaticObstacleIndex.hpp"
+#include "SpatialIndex.hpp"
+#include "Spectator.hpp"
+#include "Sweep.hpp"
 
-constexpr int STAGE_WIDTH = 1280;
-constexpr int STAGE_HEIGHT = 720;
-constexpr Vector2 STAGE_SIZE = {static_cast<float>(STAGE_WIDTH), static_cast<float>(STAGE_HEIGHT)};
-constexpr Rectangle STAGE_RECT = {0.0f, 0.0f, STAGE_SIZE.x, STAGE_SIZE.y};
-constexpr Vector2 ZERO = {0.0f, 0.0f};
 constexpr auto CLEAR_COLOR = WHITE;
-constexpr float TO_RAD = DEG2RAD;
-constexpr float TO_DEG = RAD2DEG;
 constexpr int BOID_COUNT = 80;
 constexpr int OBSTACLE_COUNT = 6;
 constexpr int TARGET_FPS = 60;
 constexpr int FONT_SIZE = 20;
-
-constexpr static float to_float(int value) noexcept{
-   return static_cast<float>(value);
-}
-
-constexpr static float range01() noexcept{
-   constexpr auto RAND_MAXF = to_float(RAND_MAX);
-   return to_float(GetRandomValue(0, RAND_MAX)) / RAND_MAXF;
-}
-
-constexpr static float unit_range() noexcept{
-   return (range01() * 2.0f) - 1.0f;
-}
-
-constexpr static float random_range(float min, float max) noexcept{
-   return min + ((max - min) * range01());
-}
-
-constexpr static Vector2 random_range(const Vector2& min, const Vector2& max) noexcept{
-   return {
-      random_range(min.x, max.x),
-      random_range(min.y, max.y)
-   };
-}
-
-static Vector2 vector_from_angle(float angle, float magnitude) noexcept{
-   return {std::cos(angle) * magnitude, std::sin(angle) * magnitude};
-}
-
-constexpr static Vector2 world_wrap(Vector2 pos, Vector2 world_size) noexcept{
-   if(pos.x > world_size.x) pos.x -= world_size.x;
-   else if(pos.x < 0) pos.x += world_size.x;
-   if(pos.y > world_size.y) pos.y -= world_size.y;
-   else if(pos.y < 0) pos.y += world_size.y;
-   return pos;
-}
-struct Obstacle final{
-   Vector2 position = random_range({50.0f, 50.0f}, STAGE_SIZE);
-   float radius = random_range(15.0f, 50.0f);
-   Color color = BLUE;
-
-   void render() const noexcept{
-      DrawCircleV(position, radius, color);
-   }
-};
-
-struct BoidConfig final{
+constexpr float FIELD_CELL_SIZE = 16.0f; // resolution of the approximate flock field. Smaller is more exact, and slower to blur.
+constexpr float FLOW_CELL_SIZE = 16.0f;  // resolution of the goal seeking flow field. Smaller fits tighter gaps, and is slower to solve.
+constexpr const char* SHARED_STATE_NAME = "boids_workshop"; // --publish writes it, --view reads it
+constexpr double VIEWER_STALL_SECONDS = 1.0; // without a new frame for this long, --view checks on the publisher
+constexpr float COST_CELL_SIZE = 40.0f; // resolution of the cost heatmap
+constexpr uint64_t COST_DUMP_INTERVAL = 600; // steps between cost map dumps when headless
+constexpr float DEFAULT_STEP_BUDGET_MS = 4.0f; // what B governs the simulation step to, unless --budget says otherwise
+
+// The settings plus the sliders that edit them. The sliders point into this very object, so it can't be copied.
+struct BoidConfig final : BoidSettings{
    using Slider = Slider<float>;
-   Color color = RED;
-   float size = 8.0f;
-   float vision_range = 100.0f;     // how far a boid sees others
-   float cohesion_weight = 2.3f;    // strength of moving toward group center
-   float alignment_weight = 1.5f;   // strength of matching speed and direction (eg: velocity) of group
-   float separation_weight = 2.0f;  // strength of keeping distance
-   float separation_range = 100.0f; // the distance at which separation kicks in. the closer they get, the stronger the force
-   float drag = 0.01f;              // simple drag applied to the velocity
-   float min_speed = 50.0f;
-   float max_speed = 150.0f;
-   float obstacle_avoidance_margin = 110.0f;
-   float obstacle_avoidance_weight = 3.5f; // strength of avoiding obstacles
-   float wander_distance = 50.0f;  // distance ahead of the boid to project the wander circle
-   float wander_radius = 25.0f;    // size of the wander circle
-   float wander_jitter = 30.0f * TO_RAD;  // how much the wander angle changes each tick, in radians
-   float wander_weight = 1.3f;     // steering force weight for wander behavior
-   float seek_weight = 1.2f;       // steering force weight for seek behavior
+
+   BoidConfig() = default;
+   BoidConfig(const BoidConfig&) = delete;
+   BoidConfig& operator=(const BoidConfig&) = delete;
 
    std::array<Slider, 9> sliders{
        Slider{"Vision", &vision_range, 0.0f, 180.0f},
@@ -132,198 +110,509 @@ struct BoidConfig final{
    }
 };
 
-BoidConfig globalConfig{}; // default configuration for all boids
-
-struct Boid final{
-   Vector2 position = random_range(ZERO, STAGE_SIZE);
-   Vector2 velocity = vector_from_angle(random_range(0.0f, 360.0f) * TO_RAD, globalConfig.min_speed);
-   std::vector<const Boid*> visible_boids; // non-owning pointers to nearby boids
-   float wander_angle = 0.0f; // Persistent wandering angle
-
-   void update_visible_boids(const LinearQuadTree<Boid>& quad_tree){
-      visible_boids.clear();
-      quad_tree.query_range(nearby(), visible_boids);      
-   }
-
-   Rectangle nearby() const noexcept{
-      return {position.x - globalConfig.vision_range, position.y - globalConfig.vision_range, globalConfig.vision_range * 2, globalConfig.vision_range * 2};
-   }
-
-   void update(float deltaTime, std::span<const Obstacle> obstacles) noexcept{
-      Vector2 acceleration = {0, 0};
-      acceleration += obstacle_avoidance(obstacles);
-      acceleration += separation();
-      acceleration += alignment();
-      acceleration += cohesion();
-      acceleration += wander();
-      acceleration += drag();
+BoidConfig globalConfig{}; // default configuration for all boids. Only the main thread touches it, the simulation reads snapshots.
 
-      velocity += acceleration * deltaTime;
-      velocity = Vector2ClampValue(velocity, globalConfig.min_speed, globalConfig.max_speed);
+struct Window final{
+   const ObstacleMap* textured_map = nullptr; //the level 'map_texture' was made from. Made on first draw, maps don't need a window.
+   Texture2D map_texture{};
 
-      position += velocity * deltaTime;
-      position = world_wrap(position, STAGE_SIZE);
+   Window(int width, int height, std::string_view title, int fps = TARGET_FPS){
+      InitWindow(width, height, title.data());
+      SetTargetFPS(fps);
    }
-      
-   Vector2 obstacle_avoidance(std::span<const Obstacle> obstacles) const noexcept{
-      Vector2 steer{0, 0};
-      int count = 0;
-      for(const auto& obs : obstacles){
-         float safe_distance = obs.radius + globalConfig.obstacle_avoidance_margin;
-         float to_index = Vector2Distance(position, obs.position);
-         if(to_index < safe_distance){
-            Vector2 away = Vector2Normalize(position - obs.position);
-            // Scale the force by how deep the boid is within the safe distance.
-            steer += away * (safe_distance - to_index);
-            ++count;
-         }
+   Window(const Window&) = delete;
+   Window& operator=(const Window&) = delete;
+   ~Window() noexcept{
+      if(map_texture.id != 0){
+         UnloadTexture(map_texture);
       }
-      if(count == 0){ return ZERO; }
-      return (steer / to_float(count)) * globalConfig.obstacle_avoidance_weight;
-   }
-
-   Vector2 seek(Vector2 targetPos) const noexcept{
-      auto toward = Vector2Normalize(targetPos - position);
-      auto desired_velocity = toward * globalConfig.max_speed;
-      return (desired_velocity - velocity) * globalConfig.seek_weight;
-   }
-
-   Vector2 wander() noexcept{
-      Vector2 circle_center = Vector2Normalize(velocity) * globalConfig.wander_distance;
-      wander_angle += unit_range() * globalConfig.wander_jitter;
-      Vector2 displacement = {
-          cos(wander_angle) * globalConfig.wander_radius,
-          sin(wander_angle) * globalConfig.wander_radius
-      };
-      Vector2 wanderTarget = position + circle_center + displacement;
-      return seek(wanderTarget) * globalConfig.wander_weight;
+      CloseWindow();
    }
 
-   Vector2 separation() const noexcept{
-      Vector2 steer{0, 0};
-      int count = 0;
-      for(auto other : visible_boids){
-         Vector2 offset = position - other->position;
-         float to_index = Vector2Length(offset);
-         if(to_index < globalConfig.separation_range){
-            steer += Vector2Normalize(offset) * (globalConfig.separation_range - to_index); // normalize a vector pointing away from other, and scale it by the inverse of the distance
-            ++count;
+   void render(std::span<const Boid> boids, const RenderPackets& packets, const Environment& env, const SpatialIndex<Boid> auto& quad_tree, const FrameGovernor* governor,
+      const CostMap* cost_map, CostMap::Metric cost_metric) noexcept{
+      BeginDrawing();
+      ClearBackground(CLEAR_COLOR);
+      if(env.obstacle_map){
+         if(textured_map != env.obstacle_map){
+            if(map_texture.id != 0){
+               UnloadTexture(map_texture);
+            }
+            map_texture = env.obstacle_map->create_texture();
+            textured_map = env.obstacle_map;
          }
+         env.obstacle_map->render(map_texture);
       }
-      if(count == 0){ return ZERO; }
-      return (steer / to_float(count)) * globalConfig.separation_weight; // average the contributions from all neighbors, and scale by separation weight
+      if(env.flock_field){
+         env.flock_field->render();
+      }
+      if(env.flow_field){
+         env.flow_field->render();
+      }
+      const double hottest = cost_map ? cost_map->render(cost_metric) : 0.0;
+      const std::array palette = {env.config.color}; //one species for now, so every packet has colour 0
+      packets.render(env.config.size, palette);
+      if(!boids.empty()){
+         boids.front().debug_render(env.config);
+      }
+      for(const auto& obstacle : env.obstacles){
+         obstacle.render();
+      }
+      quad_tree.render();
+      DrawText("Press SPACE to pause/unpause, F to toggle the flock field. Right click to add a goal, G to clear them", 10, STAGE_HEIGHT - FONT_SIZE, FONT_SIZE, DARKGRAY);
+      DrawFPS(10, STAGE_HEIGHT - FONT_SIZE * 2);
+      DrawText(TextFormat("Integrator: %s (I to change)", to_string(env.config.integrator).data()), 120, STAGE_HEIGHT - FONT_SIZE * 2, FONT_SIZE, DARKGRAY);
+      if(cost_map){
+         DrawText(TextFormat("Heatmap of %s, hottest cell %.0f per step (M to change, H to hide)", CostMap::to_string(cost_metric).data(), hottest),
+            10, STAGE_HEIGHT - FONT_SIZE * 4, FONT_SIZE, DARKGRAY);
+      }
+      if(governor){
+         DrawText(TextFormat("Quality %zu of %zu, step %.2f of %.2f ms (B to stop governing)", governor->quality_level(), QUALITY_LEVELS.size() - 1,
+            governor->average_ms(), governor->budget()), 10, STAGE_HEIGHT - FONT_SIZE * 3, FONT_SIZE, DARKGRAY);
+      }
+      globalConfig.render();
+      EndDrawing();
    }
 
-   Vector2 alignment() const noexcept{
-      Vector2 sum{0, 0};
-      int count = 0;
-      for(auto other : visible_boids){
-         sum += other->velocity;
-         count++;
-      }
-      if(count == 0){ return ZERO; }
-      Vector2 average_velocity = sum / to_float(count);
-      Vector2 steer = average_velocity - velocity;
-      return steer * globalConfig.alignment_weight;
+   bool should_close() const noexcept{
+      return WindowShouldClose() || IsKeyPressed(KEY_ESCAPE) || IsKeyPressed(KEY_Q);
    }
+};
 
-   Vector2 cohesion() const noexcept{
-      Vector2 sum = {0, 0};
-      int count = 0;
-      for(auto other : visible_boids){
-         sum += other->position;
-         count++;
-      }
-      if(count == 0){ return ZERO; }
-      Vector2 average_position = sum / to_float(count);
-      Vector2 steer = average_position - position;
-      return steer * globalConfig.cohesion_weight;
+//Connects to a simulation running with --serve and draws what it streams. Arrows pan, +/- zoom, R changes the rate.
+int spectate(uint16_t port){
+   auto client = SpectatorClient::connect("127.0.0.1", port);
+   if(!client){
+      TraceLog(LOG_ERROR, "SPECTATOR: Nothing is serving on port %d", port);
+      return EXIT_FAILURE;
    }
+   auto window = Window(STAGE_WIDTH, STAGE_HEIGHT, "Steering #7 - spectating");
+   SpectatorView view{STAGE_RECT, 30};
+   client->subscribe(view);
+   uint64_t lastBytes = 0;
+   float sinceLastSample = 0.0f;
+   float kilobytesPerSecond = 0.0f;
+   while(!window.should_close() && client->is_connected()){
+      const float deltaTime = GetFrameTime();
+      SpectatorView wanted = view;
+      const float pan = wanted.viewport.width * 0.5f * deltaTime;
+      if(IsKeyDown(KEY_LEFT)) wanted.viewport.x -= pan;
+      if(IsKeyDown(KEY_RIGHT)) wanted.viewport.x += pan;
+      if(IsKeyDown(KEY_UP)) wanted.viewport.y -= pan;
+      if(IsKeyDown(KEY_DOWN)) wanted.viewport.y += pan;
+      const float zoom = (IsKeyPressed(KEY_EQUAL) || IsKeyPressed(KEY_KP_ADD)) ? 0.8f : (IsKeyPressed(KEY_MINUS) || IsKeyPressed(KEY_KP_SUBTRACT)) ? 1.25f : 1.0f;
+      if(zoom != 1.0f){
+         const Vector2 center = {wanted.viewport.x + wanted.viewport.width * 0.5f, wanted.viewport.y + wanted.viewport.height * 0.5f};
+         wanted.viewport.width *= zoom;
+         wanted.viewport.height *= zoom;
+         wanted.viewport.x = center.x - wanted.viewport.width * 0.5f;
+         wanted.viewport.y = center.y - wanted.viewport.height * 0.5f;
+      }
+      if(IsKeyPressed(KEY_R)) wanted.rate = (view.rate >= 60) ? 10 : static_cast<uint16_t>(view.rate * 2);
+      if(wanted.viewport.x != view.viewport.x || wanted.viewport.y != view.viewport.y || wanted.viewport.width != view.viewport.width || wanted.rate != view.rate){
+         view = wanted;
+         client->subscribe(view); //a moved viewport restarts the deltas, so panning costs full frames.
+      }
+      client->poll();
+      sinceLastSample += deltaTime;
+      if(sinceLastSample >= 1.0f){
+         kilobytesPerSecond = static_cast<float>(client->total_bytes_received() - lastBytes) / 1024.0f / sinceLastSample;
+         lastBytes = client->total_bytes_received();
+         sinceLastSample = 0.0f;
+      }
 
-   Vector2 drag() const noexcept{
-      return velocity * -globalConfig.drag;
+      BeginDrawing();
+      ClearBackground(CLEAR_COLOR);
+      const float scale = STAGE_SIZE.x / view.viewport.width;
+      const float size = globalConfig.size * scale;
+      for(const auto& boid : client->visible()){
+         const Vector2 center = {(boid.position.x - view.viewport.x) * scale, (boid.position.y - view.viewport.y) * scale};
+         draw_boid(center, vector_from_angle(boid.heading, 1.0f), size, globalConfig.color);
+      }
+      DrawText("Arrows to pan, +/- to zoom, R to change the rate", 10, STAGE_HEIGHT - FONT_SIZE, FONT_SIZE, DARKGRAY);
+      DrawText(TextFormat("%zu boids in view at %d Hz, %.1f KB/s", client->visible().size(), view.rate, kilobytesPerSecond), 10, STAGE_HEIGHT - FONT_SIZE * 2, FONT_SIZE, DARKGRAY);
+      EndDrawing();
    }
+   return 0;
+}
 
-   void render() const noexcept{
-      Vector2 local_x = (Vector2Length(velocity) != 0) ? Vector2Normalize(velocity) : Vector2{1, 0};
-      Vector2 local_y = {-local_x.y, local_x.x};
-      float L = globalConfig.size;
-      float H = globalConfig.size;
-      Vector2 tip = position + (local_x * L * 1.4f);
-      Vector2 left = position - (local_x * L) + (local_y * H);
-      Vector2 right = position - (local_x * L) - (local_y * H);
-      DrawTriangle(tip, right, left, globalConfig.color);
-   }
+//What --publish puts in shared memory each step. Boid itself owns a vector, so it can't be shared as raw bytes.
+struct SharedBoid final{
+   Vector2 position;
+   Vector2 velocity;
+};
 
-   void debug_render() const noexcept{
-      const auto debug_color = Fade(globalConfig.color, 0.1f);
-      render();
-      DrawCircleV(position, globalConfig.vision_range, debug_color);
-      for(auto other : visible_boids){
-         DrawLineV(position, other->position, debug_color);
-      }
-      DrawCircleV(position, 1, BLACK);
+//Everything --publish shares: the boids every step, the obstacles and the walls of a level image once.
+struct SharedScene final{
+   SharedFramesReader<SharedBoid> boids;
+   SharedFramesReader<Obstacle> obstacles;
+   SharedFramesReader<Rectangle> walls;
+
+   //Nothing unless a publisher has created all of them.
+   static std::optional<SharedScene> open(){
+      auto boids = SharedFramesReader<SharedBoid>::open(SHARED_STATE_NAME);
+      auto obstacles = SharedFramesReader<Obstacle>::open(std::string(SHARED_STATE_NAME) + "_obstacles");
+      auto walls = SharedFramesReader<Rectangle>::open(std::string(SHARED_STATE_NAME) + "_walls");
+      if(!boids || !obstacles || !walls){
+         return std::nullopt;
+      }
+      return SharedScene{std::move(*boids), std::move(*obstacles), std::move(*walls)};
    }
 };
 
-struct Window final{
-   Window(int width, int height, std::string_view title, int fps = TARGET_FPS){
-      InitWindow(width, height, title.data());
-      SetTargetFPS(fps);
-   }
-   ~Window() noexcept{
-      CloseWindow();
+//Renders a simulation running in another process with --publish, straight from its shared memory.
+//Any number of viewers can watch the same simulation, and a stalled viewer never slows it down.
+//When the frames stop coming and the publisher is gone, the viewer lets go of its memory (on Windows that's what
+//frees the name for the next publisher) and waits for a new one.
+int view_shared(){
+   auto scene = SharedScene::open();
+   if(!scene){
+      TraceLog(LOG_ERROR, "VIEWER: Nothing is publishing, start a simulation with --publish first");
+      return EXIT_FAILURE;
    }
-
-   void render(std::span<const Boid> boids, std::span<const Obstacle> obstacles, const LinearQuadTree<Boid>& quad_tree) const noexcept{
+   auto window = Window(STAGE_WIDTH, STAGE_HEIGHT, "Steering #7 - viewing");
+   uint64_t tornFrames = 0;
+   uint64_t lastFrame = 0;
+   double lastProgress = GetTime(); //when a new frame last came in, or the last attempt to find a publisher
+   while(!window.should_close()){
+      const double now = GetTime();
+      if(!scene && now - lastProgress > VIEWER_STALL_SECONDS){
+         scene = SharedScene::open();
+         lastProgress = now;
+         if(scene) TraceLog(LOG_INFO, "VIEWER: Found a publisher");
+      }
+      const auto frame = scene ? scene->boids.latest() : std::nullopt;
+      if(frame && frame->frame != lastFrame){
+         lastFrame = frame->frame;
+         lastProgress = now;
+      } else if(scene && now - lastProgress > VIEWER_STALL_SECONDS && !scene->boids.writer_alive()){
+         TraceLog(LOG_WARNING, "VIEWER: The publisher is gone, waiting for a new one");
+         scene.reset();
+         lastProgress = now;
+         continue;
+      }
       BeginDrawing();
       ClearBackground(CLEAR_COLOR);
-      bool drawOnce = true;
-      for(const auto& boid : boids){
-         boid.render();
-         if(drawOnce){
-            boid.debug_render();
-            drawOnce = false;
+      if(!scene){
+         DrawText("Waiting for a simulation started with --publish", 10, STAGE_HEIGHT - FONT_SIZE, FONT_SIZE, DARKGRAY);
+         EndDrawing();
+         continue;
+      }
+      if(const auto walls = scene->walls.latest()){
+         for(const auto& wall : walls->records){
+            DrawRectangleRec(wall, DARKBLUE); //the colour ObstacleMap draws them in
          }
       }
-      for(const auto& obstacle : obstacles){
-         obstacle.render();
+      if(const auto level = scene->obstacles.latest()){
+         for(const auto& obstacle : level->records){
+            obstacle.render();
+         }
+      }
+      if(frame){
+         for(const auto& boid : frame->records){
+            const Vector2 direction = (Vector2Length(boid.velocity) != 0) ? Vector2Normalize(boid.velocity) : Vector2{1, 0};
+            draw_boid(boid.position, direction, globalConfig.size, globalConfig.color);
+         }
+         //two simulation steps passed while we read, so some boids may be from a newer frame. Draw it anyway.
+         if(!frame->still_valid()) ++tornFrames;
       }
-      quad_tree.render();
-      DrawText("Press SPACE to pause/unpause", 10, STAGE_HEIGHT - FONT_SIZE, FONT_SIZE, DARKGRAY);
       DrawFPS(10, STAGE_HEIGHT - FONT_SIZE * 2);
-      globalConfig.render();
+      DrawText(TextFormat("Simulation frame %llu, %zu boids, %llu torn", static_cast<unsigned long long>(frame ? frame->frame : 0),
+         frame ? frame->records.size() : size_t{0}, static_cast<unsigned long long>(tornFrames)), 10, STAGE_HEIGHT - FONT_SIZE, FONT_SIZE, DARKGRAY);
       EndDrawing();
    }
+   return 0;
+}
+
+//Runs every variant in 'variantsPath' headless, in parallel, and writes their metrics to 'resultsPath'.
+int sweep(const std::string& variantsPath, const std::string& resultsPath, std::span<const Obstacle> obstacles, std::shared_ptr<const ObstacleMap> map){
+   const auto variants = load_sweep_variants(variantsPath, globalConfig);
+   if(!variants){
+      return EXIT_FAILURE;
+   }
+   SweepOptions options;
+   options.boid_count = BOID_COUNT;
+   const auto level = std::make_shared<const Level>(STAGE_RECT, std::vector<Obstacle>(obstacles.begin(), obstacles.end()), std::move(map));
+   TraceLog(LOG_INFO, "SWEEP: Running %zu variants of %zu boids for %u frames", variants->size(), options.boid_count, options.frames);
+   const auto results = run_sweep(*variants, options, level);
+   if(!write_sweep_results(resultsPath, *variants, results)){
+      return EXIT_FAILURE;
+   }
+   TraceLog(LOG_INFO, "SWEEP: Wrote '%s'", resultsPath.c_str());
+   return 0;
+}
 
-   bool should_close() const noexcept{
-      return WindowShouldClose() || IsKeyPressed(KEY_ESCAPE) || IsKeyPressed(KEY_Q);
+//An optional port number may follow --serve, --spectate and --metrics. Returns nothing if it isn't a valid port.
+std::optional<uint16_t> port_argument(int& i, int argc, char* argv[], uint16_t fallback = DEFAULT_SPECTATOR_PORT) noexcept{
+   if(i + 1 >= argc || argv[i + 1][0] < '0' || argv[i + 1][0] > '9'){
+      return fallback;
    }
-};
+   const std::string_view text = argv[++i];
+   unsigned port = 0;
+   const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), port);
+   if(error != std::errc{} || end != text.data() + text.size() || port < 1 || port > UINT16_MAX){
+      TraceLog(LOG_ERROR, "Invalid port '%s', expected 1 to %d", argv[i], UINT16_MAX);
+      return std::nullopt;
+   }
+   return static_cast<uint16_t>(port);
+}
 
-int main(){
-   auto window = Window(STAGE_WIDTH, STAGE_HEIGHT, "Steering #7 - tweaking the quadtree");
-   std::vector<Boid> boids(BOID_COUNT);
-   std::vector<Obstacle> obstacles(OBSTACLE_COUNT); 
+int main(int argc, char* argv[]){
+   bool useStaticLevel = false;
+   const char* levelPath = nullptr;
+   std::optional<uint16_t> servePort; //--serve runs headless and streams to spectators
+   std::optional<uint16_t> spectatePort;
+   bool publish = false; //--publish runs headless and shares its state with --view processes
+   const char* sweepPath = nullptr; //--sweep variants.csv [results.csv] runs a batch of settings, see Sweep.hpp
+   const char* resultsPath = "sweep_results.csv";
+   float stepBudget = DEFAULT_STEP_BUDGET_MS;
+   const char* costMapPath = nullptr; //--heatmap [path.csv] records where the step spends its time, see CostMap.hpp
+   bool governed = false; //--budget <ms> holds the simulation step to that, at the cost of accuracy. See Governor.hpp
+   std::optional<uint16_t> metricsPort; //--metrics [port] serves live telemetry for Prometheus on localhost, see Metrics.hpp
+   for(int i = 1; i < argc; ++i){
+      const std::string_view arg = argv[i];
+      if(arg == "--static-level") useStaticLevel = true;
+      else if(arg == "--serve"){
+         servePort = port_argument(i, argc, argv);
+         if(!servePort) return EXIT_FAILURE;
+      }
+      else if(arg == "--spectate"){
+         spectatePort = port_argument(i, argc, argv);
+         if(!spectatePort) return EXIT_FAILURE;
+      }
+      else if(arg == "--publish") publish = true;
+      else if(arg == "--view") return view_shared();
+      else if(arg == "--budget" && i + 1 < argc){
+         stepBudget = static_cast<float>(std::atof(argv[++i]));
+         governed = stepBudget > 0.0f;
+      }
+      else if(arg == "--metrics"){
+         metricsPort = port_argument(i, argc, argv, DEFAULT_METRICS_PORT);
+         if(!metricsPort) return EXIT_FAILURE;
+      }
+      else if(arg == "--heatmap"){
+         costMapPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "cost_map.csv";
+      }
+      else if(arg == "--sweep" && i + 1 < argc){
+         sweepPath = argv[++i];
+         if(i + 1 < argc && argv[i + 1][0] != '-') resultsPath = argv[++i];
+      }
+      else levelPath = argv[i];
+   }
+   if(spectatePort){
+      return spectate(*spectatePort);
+   }
+   std::optional<Window> window;
+   if(!servePort && !publish && !sweepPath){
+      window.emplace(STAGE_WIDTH, STAGE_HEIGHT, "Steering #7 - tweaking the quadtree");
+   }
+   std::optional<SpectatorServer<Boid>> server;
+   if(servePort){
+      server.emplace(*servePort);
+      if(!server->listening()){
+         TraceLog(LOG_ERROR, "SPECTATOR: Could not listen on port %d", *servePort);
+         return EXIT_FAILURE;
+      }
+      TraceLog(LOG_INFO, "SPECTATOR: Serving on port %d, connect with --spectate %d", *servePort, *servePort);
+   }
+   FirstTouchArray<Boid, HugePageAllocator<Boid>> boids(BOID_COUNT); //Constructed in parallel, so each worker's slice lives on its own NUMA node.
+   TraceLog(LOG_INFO, "MEMORY: Boid state uses %s pages", to_string(last_page_mode()).data());
+   Placement placement{Distribution::Uniform, std::random_device{}()}; //not raylib's RNG: headless runs never seed it
+   place<Boid>(boids, STAGE_RECT, globalConfig.min_speed, placement);
+   //Pass a PGM or PNG level mask (dark pixels are walls) on the command line to replace the random obstacles.
+   std::optional<ObstacleMap> level = (levelPath && !useStaticLevel) ? ObstacleMap::load(levelPath, STAGE_SIZE) : std::nullopt;
+   std::vector<Obstacle> obstacles((level || useStaticLevel) ? 0 : OBSTACLE_COUNT); 
+   ObstacleIndex<Obstacle> obstacle_index(STAGE_RECT, obstacles); //Obstacles don't move, so this is built once.
+   const std::span<const Obstacle> level_obstacles = useStaticLevel ? STATIC_LEVEL_INDEX.objects() : std::span<const Obstacle>(obstacles);
+   if(sweepPath){
+      return sweep(sweepPath, resultsPath, level_obstacles, level ? std::make_shared<const ObstacleMap>(std::move(*level)) : nullptr);
+   }
    int capacity = static_cast<int>(std::sqrt(BOID_COUNT)); //Square root of total objects is a good starting point. Profile and adjust as needed!
    //QuadTree<Boid> quad_tree(STAGE_RECT, boids, capacity); //If more than capacity boids are in a quad, it will subdivide     
    LinearQuadTree<Boid> quad_tree(STAGE_RECT, boids, capacity, 5);
+   //PyramidQuadTree<Boid> quad_tree(STAGE_RECT, boids, capacity, 5); //Implicit complete quadtree, no child pointers. Good for dense worlds.
+   //KDTree<Boid> quad_tree(STAGE_RECT, boids, capacity, 16); //Median splits adapt to the data. Good for tightly clustered flocks.
+   //AABBTree<Boid> quad_tree(boids, 10.0f); //Refit instead of rebuilt, boids are only reinserted when they leave their fat box. Good for slow movers.
+   //SweepAndPrune<Boid> quad_tree(boids); //One list sorted along the dominant axis, repaired by insertion sort each frame. Good for elongated flocks.
+   //UniformGrid<Boid> quad_tree(STAGE_RECT, boids, globalConfig.vision_range); //Parallel counting sort into cells the size of a query. Good for huge flocks.
+   //HierarchicalGrid<Boid> quad_tree(STAGE_RECT, boids, 25.0f, 4); //Grids of 25, 50, 100 and 200 units, each query picks the level matching its radius.
+   FlockField field(STAGE_SIZE, FIELD_CELL_SIZE); //Approximate cohesion and alignment for huge flocks. Separation still uses the neighbours.
+   FlowField flow(STAGE_SIZE, FLOW_CELL_SIZE); //Routes every boid to the nearest goal. Solved when the goals change, sampled every frame.
+   std::vector<Vector2> goals;
+   RenderPackets packets(boids.size()); //written by the step, read by the renderer
    bool isPaused = false;
+   bool useField = false;
+   Snapshots<BoidSettings> settings(globalConfig); //The sliders edit globalConfig, the simulation reads the latest snapshot.
+   uint64_t settingsVersion = 0; //of the snapshot the last step ran with
+   float flowClearance = 0.0f; //the boid size 'flow' was built for
+   std::optional<SharedFramesWriter<SharedBoid>> sharedBoids;
+   std::optional<SharedFramesWriter<Obstacle>> sharedObstacles;
+   std::optional<SharedFramesWriter<Rectangle>> sharedWalls;
+   if(publish){
+      const std::vector<Rectangle> walls = level ? level->wall_runs() : std::vector<Rectangle>{};
+      sharedBoids = SharedFramesWriter<SharedBoid>::create(SHARED_STATE_NAME, boids.size());
+      sharedObstacles = SharedFramesWriter<Obstacle>::create(std::string(SHARED_STATE_NAME) + "_obstacles", level_obstacles.size());
+      sharedWalls = SharedFramesWriter<Rectangle>::create(std::string(SHARED_STATE_NAME) + "_walls", walls.size());
+      if(!sharedBoids || !sharedObstacles || !sharedWalls){
+         TraceLog(LOG_ERROR, "PUBLISH: Could not create the shared memory. Is another --publish running?");
+         return EXIT_FAILURE;
+      }
+      sharedObstacles->publish(0, level_obstacles);
+      sharedWalls->publish(0, walls);
+      TraceLog(LOG_INFO, "PUBLISH: Sharing the simulation, watch it with --view");
+   }
+   uint64_t simulationFrame = 0;
+   std::optional<FrameGovernor> governor;
+   std::optional<CostMap> costMap;
+   if(costMapPath){
+      costMap.emplace(STAGE_SIZE, COST_CELL_SIZE);
+   }
+   auto costMetric = CostMap::QUERY_NS;
+   if(governed){
+      governor.emplace(stepBudget);
+   }
+   SimulationMetrics metrics;
+   std::optional<MetricsExporter> exporter; //declared after 'metrics', so its thread stops before they go away
+   if(metricsPort){
+      exporter.emplace(metrics, *metricsPort);
+      if(!exporter->listening()){
+         TraceLog(LOG_ERROR, "METRICS: Could not listen on port %d", *metricsPort);
+         return EXIT_FAILURE;
+      }
+      TraceLog(LOG_INFO, "METRICS: Serving http://127.0.0.1:%d/metrics", *metricsPort);
+   }
 
-   while(!window.should_close()){
-      float deltaTime = GetFrameTime();
+   const auto headlessStep = std::chrono::microseconds(1'000'000 / TARGET_FPS);
+   auto nextStep = std::chrono::steady_clock::now();
+   while(!window || !window->should_close()){ //headless runs until it's killed
+      float deltaTime = window ? GetFrameTime() : 1.0f / TARGET_FPS;
       if(IsKeyPressed(KEY_SPACE)) isPaused = !isPaused;
+      if(IsKeyPressed(KEY_F)) useField = !useField;
+      if(IsKeyPressed(KEY_P)){
+         placement.distribution = static_cast<Distribution>((std::to_underlying(placement.distribution) + 1) % 3);
+         place<Boid>(boids, STAGE_RECT, settings.acquire()->value.min_speed, placement);
+         TraceLog(LOG_INFO, "PLACEMENT: %s", to_string(placement.distribution).data());
+      }
+      if(IsKeyPressed(KEY_B)){
+         if(governor) governor.reset();
+         else governor.emplace(stepBudget > 0.0f ? stepBudget : DEFAULT_STEP_BUDGET_MS);
+      }
+      if(IsKeyPressed(KEY_H)){
+         if(costMap) costMap.reset();
+         else costMap.emplace(STAGE_SIZE, COST_CELL_SIZE);
+      }
+      if(IsKeyPressed(KEY_M)) costMetric = static_cast<CostMap::Metric>((costMetric + 1) % CostMap::METRIC_COUNT);
+      if(IsKeyPressed(KEY_I)) globalConfig.integrator = static_cast<Integrator>((std::to_underlying(globalConfig.integrator) + 1) % 3);
+      bool goalsChanged = false;
+      if(IsMouseButtonPressed(MOUSE_BUTTON_RIGHT) || IsKeyPressed(KEY_G)){
+         if(IsKeyPressed(KEY_G)) goals.clear();
+         else goals.push_back(GetMousePosition());
+         goalsChanged = true;
+      }
             
+      const auto stepStart = std::chrono::steady_clock::now();
+      const uint64_t allocationsBefore = exporter ? step_allocation_count() : 0;
+      const Quality quality = governor ? governor->quality() : Quality{};
+      const bool farField = useField || quality.far_field;
+      CostMap* const costs = (costMap && !isPaused) ? &*costMap : nullptr;
+      if(costs){
+         costs->begin_frame(boids.size());
+      }
       quad_tree.rebuild(boids);
       globalConfig.update();     
-
-      for(auto& boid : boids){
-         boid.update_visible_boids(quad_tree);
-         if(isPaused) continue;
-         boid.update(deltaTime, obstacles);
+      settings.publish(globalConfig); // step boundary, and a no-op unless a slider moved. Everything below reads this snapshot.
+      const auto snapshot = settings.acquire();
+      const BoidSettings& config = snapshot->value;
+      if(goalsChanged || (snapshot->version != settingsVersion && config.size != flowClearance)){ //the flow field keeps boids a body width from the walls
+         flow.rebuild<Obstacle>(goals, level_obstacles, config.size, level ? &*level : nullptr);
+         flowClearance = config.size;
+      }
+      settingsVersion = snapshot->version;
+      if(farField){
+         field.rebuild<Boid>(boids, config.vision_range);
+      }
+      // the field covers the whole vision range, so the neighbour query only has to reach as far as separation.
+      const float query_range = farField ? config.separation_range : config.vision_range;
+      const Environment env{config, level_obstacles, useStaticLevel ? nullptr : &obstacle_index, farField ? &field : nullptr, flow.empty() ? nullptr : &flow,
+         level ? &*level : nullptr, useStaticLevel ? &STATIC_LEVEL_INDEX : nullptr, STAGE_SIZE, quality.max_substeps};
+
+      // the queries only read the index and write the boid's own list, so they run on the workers.
+      parallel_for(boids.size(), workers_for(boids.size()), [&](size_t, size_t begin, size_t end){
+         for(size_t i = begin; i < end; ++i){
+            if((i + simulationFrame) % quality.refresh_interval != 0){ // the rest keep last step's neighbours. Boids never move in memory, so those pointers hold.
+               continue;
+            }
+            if(!costs){
+               boids[i].update_visible_boids(quad_tree, query_range, quality.neighbour_cap);
+               continue;
+            }
+            const auto queryStart = std::chrono::steady_clock::now();
+            const size_t tested = boids[i].update_visible_boids(quad_tree, query_range, quality.neighbour_cap);
+            const std::chrono::duration<float, std::nano> queryTime = std::chrono::steady_clock::now() - queryStart;
+            costs->record_query(i, boids[i].position, tested, queryTime.count());
+         }
+      });
+      // steering reads the neighbours as they move, and wander draws from raylib's RNG, so this stays serial.
+      // Each boid's render packet is written right after its update, while the boid is still in cache.
+      for(size_t i = 0; i < boids.size(); ++i){
+         if(!isPaused && !costs){
+            boids[i].update(deltaTime, env, unit_range());
+         } else if(!isPaused){
+            const auto steerStart = std::chrono::steady_clock::now();
+            boids[i].update(deltaTime, env, unit_range());
+            const std::chrono::duration<float, std::nano> steerTime = std::chrono::steady_clock::now() - steerStart;
+            costs->record_steering(i, boids[i].position, steerTime.count());
+         }
+         if(window){ //paused too, P can place the flock anew
+            packets.write(i, boids[i].position, boids[i].velocity);
+         }
+      }
+      if(costs){
+         costs->finish_frame();
+      }
+      const std::chrono::duration<float, std::milli> stepTime = std::chrono::steady_clock::now() - stepStart;
+      if(exporter){ //the exporter thread only ever reads these
+         metrics.allocations_last_step.store(step_allocation_count() - allocationsBefore, std::memory_order_relaxed);
+         metrics.step_seconds.observe(stepTime.count() / 1000.0);
+         metrics.neighbours.observe_all(boids, [](const Boid& boid){ return static_cast<double>(boid.visible_boids.size()); });
+         metrics.boids.store(boids.size(), std::memory_order_relaxed);
+         if constexpr(requires{ quad_tree.stats(); }){
+            const auto stats = quad_tree.stats();
+            metrics.index_nodes.store(stats.nodes, std::memory_order_relaxed);
+            metrics.index_leaves.store(stats.leaves, std::memory_order_relaxed);
+            metrics.index_largest_leaf.store(stats.largest_leaf, std::memory_order_relaxed);
+         }
+         metrics.steps.fetch_add(1, std::memory_order_relaxed);
+      }
+      if(governor){
+         if(governor->record(stepTime.count())){
+            TraceLog(LOG_INFO, "GOVERNOR: Quality level %zu at %.2f ms per step", governor->quality_level(), governor->average_ms());
+         }
       }
 
-      window.render(boids, obstacles, quad_tree);
+      if(server){
+         server->update(boids, quad_tree, deltaTime);
+      }
+      if(sharedBoids){
+         sharedBoids->publish(simulationFrame, boids.size(), [&](std::span<SharedBoid> out){
+            for(size_t i = 0; i < out.size(); ++i){
+               out[i] = {boids[i].position, boids[i].velocity};
+            }
+         });
+      }
+      ++simulationFrame;
+      if(window){
+         window->render(boids, packets, env, quad_tree, governor ? &*governor : nullptr, costMap ? &*costMap : nullptr, costMetric);
+      } else{
+         if(costMap && costMapPath && simulationFrame % COST_DUMP_INTERVAL == 0){
+            costMap->dump(costMapPath);
+         }
+         nextStep += headlessStep;
+         std::this_thread::sleep_until(nextStep);
+      }
+   }
+   if(costMap && costMapPath){
+      costMap->dump(costMapPath);
    }
    return 0;
 }
\ No newline at end of file